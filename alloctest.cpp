@@ -0,0 +1,165 @@
+#include "game.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+// replays a script of game commands and counts what each pass does on the
+// heap once warmed up. this is its own program ('make alloctest') so the
+// counting allocator below is never linked into xhud itself.
+//
+// operator new is what xhud and libxwing use, and is expected to be 0.
+// malloc is counted separately: gd's freetype text drawing and libpng's
+// encoder allocate inside every frame, so frames are not allocation-free
+// and that count is reported rather than checked.
+//
+// malloc and friends are defined here so they also catch the calls made
+// from inside the shared libgd/libpng/libfreetype (-Wl,--wrap would only
+// see calls from our own objects). that needs glibc's __libc_ entry
+// points; elsewhere only operator new is counted.
+
+static bool   counting    = false;
+static size_t newCount    = 0;
+static size_t mallocCount = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t n, size_t size);
+  void* __libc_realloc(void *p, size_t size);
+  void  __libc_free(void *p);
+
+  void* malloc(size_t size)              { if(counting) mallocCount++; return __libc_malloc(size); }
+  void* calloc(size_t n, size_t size)    { if(counting) mallocCount++; return __libc_calloc(n, size); }
+  void* realloc(void *p, size_t size)    { if(counting) mallocCount++; return __libc_realloc(p, size); }
+  void  free(void *p)                    { __libc_free(p); }
+}
+#define RAWMALLOC __libc_malloc
+#define RAWFREE   __libc_free
+#define COUNTSMALLOC true
+#else
+#define RAWMALLOC malloc
+#define RAWFREE   free
+#define COUNTSMALLOC false
+#endif
+
+void* operator new(size_t size) {
+  if(counting) newCount++;
+  void *p = RAWMALLOC(size ? size : 1);
+  if(!p) throw std::bad_alloc();
+  return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, std::nothrow_t const &) noexcept {
+  if(counting) newCount++;
+  return RAWMALLOC(size ? size : 1);
+}
+void* operator new[](size_t size, std::nothrow_t const &nt) noexcept { return operator new(size, nt); }
+void operator delete(void *p) noexcept                              { RAWFREE(p); }
+void operator delete[](void *p) noexcept                            { RAWFREE(p); }
+void operator delete(void *p, size_t) noexcept                      { RAWFREE(p); }
+void operator delete[](void *p, size_t) noexcept                    { RAWFREE(p); }
+void operator delete(void *p, std::nothrow_t const &) noexcept      { RAWFREE(p); }
+void operator delete[](void *p, std::nothrow_t const &) noexcept    { RAWFREE(p); }
+
+
+
+struct Counts {
+  size_t news;
+  size_t mallocs;
+};
+
+static void RemoveDir(std::string dir) {
+  DIR *d = opendir(dir.c_str());
+  if(d) {
+    struct dirent *e;
+    while((e = readdir(d))) {
+      if((strcmp(e->d_name, ".") != 0) && (strcmp(e->d_name, "..") != 0)) {
+        unlink((dir + "/" + e->d_name).c_str());
+      }
+    }
+    closedir(d);
+  }
+  rmdir(dir.c_str());
+}
+
+// plays the script through a game once to warm up (fonts, png buffers,
+// arena) then again while counting. false on error
+static bool CountGameAllocs(std::string f1, std::string f2, std::vector<std::string> const &script, bool combined, Counts &c) {
+  char dir[] = "/tmp/xhud-alloctest-XXXXXX";
+  if(!mkdtemp(dir)) return false;
+  bool ok = false;
+  fflush(stdout);
+  int out = dup(1);
+  int devnull = open("/dev/null", O_WRONLY);
+  try {
+    std::array<Squad, 2> players = { { Squad(f1), Squad(f2) } };
+    Game g(players, dir, combined);
+    dup2(devnull, 1);
+    for(auto const &cmd : script) g.Step(cmd);
+    fflush(stdout);
+    newCount = mallocCount = 0;
+    counting = true;
+    for(auto const &cmd : script) g.Step(cmd);
+    fflush(stdout);
+    counting = false;
+    c = { newCount, mallocCount };
+    ok = true;
+  }
+  catch(std::invalid_argument ia) {
+    counting = false;
+    fflush(stdout);
+    dup2(out, 1);
+    printf("Error: %s\n", ia.what());
+  }
+  dup2(out, 1);
+  close(out);
+  close(devnull);
+  RemoveDir(dir);
+  return ok;
+}
+
+
+
+int main(int argc, char *argv[]) {
+  if(argc != 4) {
+    printf("usage: alloctest {L1} {L2} {S}\n");
+    printf("  plays the game commands in script (S) with lists (L1) and (L2) and\n");
+    printf("  fails if they call operator new once warmed up\n");
+    return 1;
+  }
+
+  std::vector<std::string> script;
+  std::ifstream in(argv[3]);
+  if(!in) { printf("Could not read '%s'\n", argv[3]); return 1; }
+  std::string line;
+  while(std::getline(in, line)) {
+    if((line.length() > 0) && (line[0] != '#') && (line != "qqq")) script.push_back(line);
+  }
+
+  bool ok = true;
+  for(bool combined : {false, true}) {
+    printf("%-8s (%zu commands)\n", combined ? "combined" : "normal", script.size());
+    Counts c;
+    if(!CountGameAllocs(argv[1], argv[2], script, combined, c)) {
+      printf("  \e[1;31mERROR\x1B[0m\n");
+      ok = false;
+      continue;
+    }
+    printf("  operator new - %zu - %s\n", c.news, c.news ? "\e[1;31mFAILED\x1B[0m" : "Ok");
+    if(!COUNTSMALLOC) {
+      printf("  malloc       - not counted on this platform\n");
+    } else {
+      printf("  malloc       - %zu (%.1f per command) - %s\n", c.mallocs, script.size() ? (double)c.mallocs / script.size() : 0,
+             c.mallocs ? "\e[1;33mframes are NOT allocation-free\x1B[0m (gd, libpng, freetype and stdio; not checked)" : "Ok");
+    }
+    if(c.news) ok = false;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdarg.h>
+#include <stdio.h>
+#include <vector>
+
+// bump allocator for text that only has to live until the frame is drawn.
+// memory is grabbed once up front and Reset() hands all of it back, so
+// formatting labels while rendering never touches the heap.
+// anything that does not fit is truncated rather than allocated.
+class FrameArena {
+ public:
+  FrameArena(size_t size) : buf(size), used(0) { }
+  void Reset() { this->used = 0; }
+
+  const char* Printf(const char *fmt, ...) {
+    if(this->used >= this->buf.size()) return "";
+    size_t left = this->buf.size() - this->used;
+    char *s = &this->buf[this->used];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(s, left, fmt, args);
+    va_end(args);
+    if(len < 0) { s[0] = 0; len = 0; }
+    this->used += ((size_t)len < left) ? len+1 : left;
+    return s;
+  }
+
+ private:
+  std::vector<char> buf;
+  size_t used;
+};
@@ -0,0 +1,478 @@
+#include "builder.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+const int MAXPOINTS = 100;
+
+// titles that add a slot which can hold any one of the listed types
+struct ChoiceSlot {
+  const char *title; // xws key
+  std::vector<Upg> types;
+};
+static const std::vector<ChoiceSlot> choiceSlots = {
+  { "heavyscykinterceptor", { Upg::Cannon, Upg::Torpedo, Upg::Missile } },
+};
+
+// keeps a count going up or down and tracks how many copies are over 1
+static void Count(std::unordered_map<std::string, int> &counts, std::string const &key, int delta, int &dupes) {
+  int &c = counts[key];
+  dupes -= std::max(0, c-1);
+  c += delta;
+  dupes += std::max(0, c-1);
+}
+
+Builder::Builder(std::string f, std::string preview)
+  : faction(f), previewPath(preview), isRunning(true), echo(true),
+    cost(0), uniqueDupes(0), limitedDupes(0), slotsOver(0),
+    render(WIDTH, HEIGHT) {
+}
+
+void Builder::Run() {
+  std::string line;
+  this->PrintStatus();
+  do {
+    printf("build> ");
+    if(!std::getline(std::cin, line)) break;
+    if(this->ParseCommand(line)) {
+      this->PrintStatus();
+      this->UpdatePreview();
+    }
+  } while(this->isRunning);
+}
+
+void Builder::AddUnique(std::string const &n, int delta) {
+  Count(this->uniques, n, delta, this->uniqueDupes);
+}
+
+// upgrades on the ship without a slot of their own. the slots a title adds
+// take the overflow from any of their types
+int Builder::GetSlotsOver(Ship const &s) const {
+  int over = 0;
+  int choiceOver = 0;
+  for(auto const &u : s.used) {
+    auto avail = s.slots.find(u.first);
+    int o = std::max(0, u.second - ((avail == s.slots.end()) ? 0 : avail->second));
+    over += o;
+    if(std::find(s.choiceTypes.begin(), s.choiceTypes.end(), u.first) != s.choiceTypes.end()) choiceOver += o;
+  }
+  return over - std::min(choiceOver, s.choiceSlots);
+}
+
+void Builder::ApplyUpgrade(Ship &s, Upgrade &u, int delta) {
+  this->cost += delta * u.GetCost();
+  if(u.GetIsUnique())  { this->AddUnique(u.GetUpgradeName(), delta); }
+  if(u.GetIsLimited()) { Count(s.limited, u.GetUpgradeName(), delta, this->limitedDupes); }
+  this->slotsOver -= this->GetSlotsOver(s);
+  s.used[u.GetType()] += delta;
+  if(u.GetType() == Upg::Title) {
+    for(auto const &c : choiceSlots) {
+      if(u.GetUpgradeNameXws() == c.title) {
+        s.choiceSlots += delta;
+        s.choiceTypes = c.types;
+      }
+    }
+  }
+  this->slotsOver += this->GetSlotsOver(s);
+}
+
+bool Builder::AddShip(std::string const &shipXws, std::string const &pilotXws) {
+  try {
+    this->ships.push_back({ Pilot::GetPilot(pilotXws, this->faction, shipXws), pilotXws, shipXws, {}, {}, {}, {}, 0, {} });
+  }
+  catch(std::invalid_argument e) {
+    if(this->echo) printf("Unknown pilot '%s' for ship '%s' (%s)\n", pilotXws.c_str(), shipXws.c_str(), this->faction.c_str());
+    return false;
+  }
+  Ship &s = this->ships.back();
+  for(Upg u : s.pilot.GetNatPossibleUpgrades()) { s.slots[u]++; }
+  this->cost += s.pilot.GetNatCost();
+  if(s.pilot.GetIsUnique()) { this->AddUnique(s.pilot.GetPilotName(), 1); }
+  if(this->echo) printf("  Ship %zu - %s\n", this->ships.size(), s.pilot.GetPilotName().c_str());
+  return true;
+}
+
+bool Builder::RemoveShip(size_t n) {
+  if((n < 1) || (n > this->ships.size())) { printf("Invalid ship\n"); return false; }
+  Ship &s = this->ships[n-1];
+  for(auto &a : s.upgrades) { this->ApplyUpgrade(s, a.upgrade, -1); }
+  this->cost -= s.pilot.GetNatCost();
+  if(s.pilot.GetIsUnique()) { this->AddUnique(s.pilot.GetPilotName(), -1); }
+  printf("  Removed %s\n", s.pilot.GetPilotName().c_str());
+  this->ships.erase(this->ships.begin() + (n-1));
+  return true;
+}
+
+bool Builder::AddUpgrade(size_t n, std::string const &type, std::string const &upgXws) {
+  if((n < 1) || (n > this->ships.size())) { printf("Invalid ship\n"); return false; }
+  // xws keys are only unique within a slot type, so the type is part of the lookup
+  std::string key = type + "/" + upgXws;
+  auto it = this->upgradeIndex.find(key);
+  if(it == this->upgradeIndex.end()) {
+    try {
+      it = this->upgradeIndex.insert({key, Upgrade::GetUpgrade(type, upgXws)}).first;
+    }
+    catch(std::invalid_argument e) {
+      if(this->echo) printf("Unknown upgrade '%s' for slot type '%s'\n", upgXws.c_str(), type.c_str());
+      return false;
+    }
+  }
+  Ship &s = this->ships[n-1];
+  s.upgrades.push_back({type, it->second});
+  this->ApplyUpgrade(s, s.upgrades.back().upgrade, 1);
+  if(this->echo) printf("  Ship %zu - %s + %s\n", n, s.pilot.GetPilotName().c_str(), it->second.GetUpgradeName().c_str());
+  return true;
+}
+
+bool Builder::RemoveUpgrade(size_t n, std::string const &type, std::string const &upgXws) {
+  if((n < 1) || (n > this->ships.size())) { printf("Invalid ship\n"); return false; }
+  Ship &s = this->ships[n-1];
+  for(auto a = s.upgrades.begin(); a != s.upgrades.end(); a++) {
+    if((a->type == type) && (a->upgrade.GetUpgradeNameXws() == upgXws)) {
+      this->ApplyUpgrade(s, a->upgrade, -1);
+      printf("  Ship %zu - %s - %s\n", n, s.pilot.GetPilotName().c_str(), a->upgrade.GetUpgradeName().c_str());
+      s.upgrades.erase(a);
+      return true;
+    }
+  }
+  printf("Ship %zu has no '%s' in slot type '%s'\n", n, upgXws.c_str(), type.c_str());
+  return false;
+}
+
+std::vector<std::string> Builder::GetIssues() const {
+  std::vector<std::string> issues;
+  if(this->cost > MAXPOINTS)  { issues.push_back("Over " + std::to_string(MAXPOINTS) + " points"); }
+  if(this->uniqueDupes > 0)   { issues.push_back("Unique name used more than once"); }
+  if(this->limitedDupes > 0)  { issues.push_back("Limited card used more than once on a ship"); }
+  if(this->slotsOver > 0)     { issues.push_back("Upgrade without an open slot"); }
+  issues.insert(issues.end(), this->loadIssues.begin(), this->loadIssues.end());
+  return issues;
+}
+
+void Builder::PrintStatus() const {
+  std::vector<std::string> issues = this->GetIssues();
+  printf("  %d/%d points - %zu ship(s) - %s\n", this->cost, MAXPOINTS, this->ships.size(), issues.size() ? "\e[1;31mINVALID\x1B[0m" : "Ok");
+  for(auto const &i : issues) {
+    printf("    \e[1;31m%s\x1B[0m\n", i.c_str());
+  }
+}
+
+void Builder::PrintList() const {
+  int n = 1;
+  for(auto const &s : this->ships) {
+    Pilot p = s.pilot;
+    printf("  %d - %-30s (%s/%s)\n", n++, p.GetPilotName().c_str(), s.shipXws.c_str(), s.pilotXws.c_str());
+    for(auto const &a : s.upgrades) {
+      Upgrade u = a.upgrade;
+      printf("        %-24s (%s/%s)\n", u.GetUpgradeName().c_str(), a.type.c_str(), u.GetUpgradeNameXws().c_str());
+    }
+  }
+}
+
+// just enough json to read an xws file back in. objects, arrays and
+// strings are understood, anything else is skipped over
+struct JsonText {
+  std::string const &text;
+  size_t pos;
+};
+
+static void JsonError(JsonText &j, std::string const &what) {
+  throw std::invalid_argument("Bad xws at offset " + std::to_string(j.pos) + ": " + what);
+}
+
+static char JsonPeek(JsonText &j) {
+  while((j.pos < j.text.length()) && isspace((unsigned char)j.text[j.pos])) j.pos++;
+  if(j.pos >= j.text.length()) JsonError(j, "unexpected end");
+  return j.text[j.pos];
+}
+
+static void JsonExpect(JsonText &j, char c) {
+  if(JsonPeek(j) != c) JsonError(j, std::string("expected '") + c + "'");
+  j.pos++;
+}
+
+// null reads as ""
+static std::string JsonReadString(JsonText &j) {
+  JsonPeek(j);
+  if(j.text.compare(j.pos, 4, "null") == 0) { j.pos += 4; return ""; }
+  JsonExpect(j, '"');
+  std::string ret;
+  while(j.pos < j.text.length()) {
+    char c = j.text[j.pos++];
+    if(c == '"') return ret;
+    if(c == '\\') {
+      if(j.pos >= j.text.length()) break;
+      c = j.text[j.pos++];
+      switch(c) {
+      case 'n': ret += '\n'; break;
+      case 't': ret += '\t'; break;
+      case 'u': ret += '?'; j.pos += 4; break; // xws keys are plain ascii
+      default:  ret += c;    break;
+      }
+    } else {
+      ret += c;
+    }
+  }
+  JsonError(j, "unterminated string");
+  return ret;
+}
+
+static void JsonSkip(JsonText &j);
+
+static void JsonForEachMember(JsonText &j, std::function<void(std::string const &key)> f) {
+  JsonExpect(j, '{');
+  if(JsonPeek(j) == '}') { j.pos++; return; }
+  for(;;) {
+    std::string key = JsonReadString(j);
+    JsonExpect(j, ':');
+    f(key);
+    if(JsonPeek(j) != ',') break;
+    j.pos++;
+  }
+  JsonExpect(j, '}');
+}
+
+static void JsonForEachElement(JsonText &j, std::function<void()> f) {
+  JsonExpect(j, '[');
+  if(JsonPeek(j) == ']') { j.pos++; return; }
+  for(;;) {
+    f();
+    if(JsonPeek(j) != ',') break;
+    j.pos++;
+  }
+  JsonExpect(j, ']');
+}
+
+static void JsonSkip(JsonText &j) {
+  switch(JsonPeek(j)) {
+  case '{': JsonForEachMember(j, [&j](std::string const &) { JsonSkip(j); }); break;
+  case '[': JsonForEachElement(j, [&j]() { JsonSkip(j); });                   break;
+  case '"': JsonReadString(j);                                               break;
+  default:
+    while((j.pos < j.text.length()) && !strchr(",}] \t\r\n", j.text[j.pos])) j.pos++;
+    break;
+  }
+}
+
+XwsList ReadXws(std::string const &file) {
+  std::ifstream in(file);
+  if(!in) throw std::invalid_argument("Unable to read '" + file + "'");
+  std::stringstream ss;
+  ss << in.rdbuf();
+  std::string text = ss.str();
+  JsonText j = { text, 0 };
+  XwsList list;
+  JsonForEachMember(j, [&](std::string const &key) {
+      if(key == "name")         { list.name = JsonReadString(j); }
+      else if(key == "faction") { list.faction = JsonReadString(j); }
+      else if(key == "pilots") {
+        JsonForEachElement(j, [&]() {
+            XwsList::Ship s;
+            JsonForEachMember(j, [&](std::string const &key) {
+                if(key == "name")      { s.pilot = JsonReadString(j); }
+                else if(key == "ship") { s.ship = JsonReadString(j); }
+                else if(key == "upgrades") {
+                  JsonForEachMember(j, [&](std::string const &type) {
+                      JsonForEachElement(j, [&]() { s.upgrades.push_back({ type, JsonReadString(j) }); });
+                    });
+                }
+                else { JsonSkip(j); }
+              });
+            list.pilots.push_back(s);
+          });
+      }
+      else { JsonSkip(j); }
+    });
+  return list;
+}
+
+static std::string JsonString(std::string const &s) {
+  std::string ret = "\"";
+  for(char c : s) {
+    if((c == '"') || (c == '\\')) ret += '\\';
+    ret += c;
+  }
+  return ret + "\"";
+}
+
+bool Builder::Save(std::string const &file) const {
+  std::ofstream out(file);
+  if(!out) {
+    printf("Unable to write '%s'\n", file.c_str());
+    return false;
+  }
+  out << "{\n";
+  out << "  \"name\": " << JsonString(this->name) << ",\n";
+  out << "  \"faction\": " << JsonString(this->faction) << ",\n";
+  out << "  \"points\": " << this->cost << ",\n";
+  out << "  \"pilots\": [";
+  for(size_t i=0; i<this->ships.size(); i++) {
+    Ship const &s = this->ships[i];
+    Pilot p = s.pilot;
+    int points = p.GetNatCost();
+    for(auto const &a : s.upgrades) { Upgrade u = a.upgrade; points += u.GetCost(); }
+    out << (i ? "," : "") << "\n    {\n";
+    out << "      \"name\": " << JsonString(s.pilotXws) << ",\n";
+    out << "      \"ship\": " << JsonString(s.shipXws) << ",\n";
+    out << "      \"points\": " << points;
+    // group by slot type the way xws expects
+    std::vector<std::string> types;
+    for(auto const &a : s.upgrades) {
+      if(std::find(types.begin(), types.end(), a.type) == types.end()) types.push_back(a.type);
+    }
+    if(types.size()) {
+      out << ",\n      \"upgrades\": {";
+      for(size_t t=0; t<types.size(); t++) {
+        out << (t ? "," : "") << "\n        " << JsonString(types[t]) << ": [";
+        bool first = true;
+        for(auto const &a : s.upgrades) {
+          if(a.type != types[t]) continue;
+          Upgrade u = a.upgrade;
+          out << (first ? "" : ", ") << JsonString(u.GetUpgradeNameXws());
+          first = false;
+        }
+        out << "]";
+      }
+      out << "\n      }";
+    }
+    out << "\n    }";
+  }
+  out << "\n  ],\n";
+  out << "  \"version\": \"1.0.0\"\n";
+  out << "}\n";
+  return true;
+}
+
+// feeds a list through the same add/up steps as the prompt. anything that
+// can not be added (ie. a pilot from another faction) becomes an issue
+void Builder::Load(XwsList const &list) {
+  bool wasEcho = this->echo;
+  this->echo = false;
+  if(list.name != "") this->name = list.name;
+  if(list.faction != this->faction) {
+    this->loadIssues.push_back("List is for faction '" + list.faction + "', not '" + this->faction + "'");
+  }
+  for(auto const &p : list.pilots) {
+    if(!this->AddShip(p.ship, p.pilot)) {
+      this->loadIssues.push_back("Pilot '" + p.pilot + "' (" + p.ship + ") is not available to " + this->faction);
+      continue;
+    }
+    for(auto const &u : p.upgrades) {
+      if(!this->AddUpgrade(this->ships.size(), u.first, u.second)) {
+        this->loadIssues.push_back("Unknown upgrade '" + u.second + "' for slot type '" + u.first + "'");
+      }
+    }
+  }
+  this->echo = wasEcho;
+}
+
+// the preview goes through a real xws round trip so it shows exactly what
+// would be saved
+void Builder::UpdatePreview() {
+  if(this->previewPath == "") return;
+  std::string xws = this->previewPath + ".xws.tmp";
+  if(!this->Save(xws)) return;
+  try {
+    Squad sq = Squad(xws);
+    this->render.Render(sq);
+    this->render.WritePng(this->previewPath);
+  }
+  catch(std::invalid_argument e) {
+    printf("Preview failed: %s\n", e.what());
+  }
+  unlink(xws.c_str());
+}
+
+// return is whether or not the list changed
+bool Builder::ParseCommand(std::string const &cmd) {
+  std::istringstream ss(cmd);
+  std::string c;
+  ss >> c;
+
+  if(c == "qqq") {
+    this->isRunning = false;
+    return false;
+  }
+
+  if(c == "?") {
+    printf("Commands:\n");
+    printf("  ?              - help\n");
+    printf("  qqq            - quit\n");
+    printf("  ls             - list ships and upgrades\n");
+    printf("  name {N}       - set the squad name\n");
+    printf("  add {S} {P}    - add pilot P flying ship S (xws keys)\n");
+    printf("  rm {N}         - remove ship N\n");
+    printf("  up {N} {T} {U} - attach upgrade U (xws key) in slot type T (xws key) to ship N\n");
+    printf("  down {N} {T} {U} - detach upgrade U (xws key) in slot type T (xws key) from ship N\n");
+    printf("  save {F}       - verify and write the list to F\n");
+    printf("  Examples:\n");
+    printf("    add xwing lukeskywalker\n");
+    printf("    up 1 amd r2d2\n");
+    return false;
+  }
+
+  if(c == "ls") {
+    this->PrintList();
+    return false;
+  }
+
+  if(c == "name") {
+    std::getline(ss >> std::ws, this->name);
+    return true;
+  }
+
+  if(c == "add") {
+    std::string ship, pilot;
+    ss >> ship >> pilot;
+    return this->AddShip(ship, pilot);
+  }
+
+  if(c == "rm") {
+    size_t n = 0;
+    ss >> n;
+    return this->RemoveShip(n);
+  }
+
+  if(c == "up") {
+    size_t n = 0;
+    std::string type, upg;
+    ss >> n >> type >> upg;
+    return this->AddUpgrade(n, type, upg);
+  }
+
+  if(c == "down") {
+    size_t n = 0;
+    std::string type, upg;
+    ss >> n >> type >> upg;
+    return this->RemoveUpgrade(n, type, upg);
+  }
+
+  if(c == "save") {
+    std::string file;
+    ss >> file;
+    if(file == "" || !this->Save(file)) return false;
+    // anything the running counters do not cover is caught here
+    try {
+      std::vector<std::string> issues = Squad(file).Verify();
+      printf("  Saved %s - %s\n", file.c_str(), issues.size() ? "\e[1;31mINVALID\x1B[0m" : "Ok");
+      for(auto const &i : issues) {
+        printf("    \e[1;31m%s\x1B[0m\n", i.c_str());
+      }
+    }
+    catch(std::invalid_argument e) {
+      printf("  Saved %s - \e[1;31m%s\x1B[0m\n", file.c_str(), e.what());
+    }
+    return false;
+  }
+
+  if(c != "") {
+    printf("Unknown command '%s' ('?' for help)\n", c.c_str());
+  }
+  return false;
+}
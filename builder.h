@@ -0,0 +1,84 @@
+#pragma once
+#include "./libxwing/squad.h"
+#include "imagegen.h"
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// an xws file as read back for Builder::Load, upgrades as (slot type, xws key)
+struct XwsList {
+  struct Ship {
+    std::string ship;
+    std::string pilot;
+    std::vector<std::pair<std::string, std::string>> upgrades;
+  };
+  std::string name;
+  std::string faction;
+  std::vector<Ship> pilots;
+};
+
+// throws std::invalid_argument if the file can not be read or parsed
+XwsList ReadXws(std::string const &file);
+
+
+
+// interactive list builder.
+// cost, unique names, limited cards and slot usage are kept as running
+// counters so each edit only adjusts what it touched. the full
+// Squad::Verify pass only runs when the list is saved.
+class Builder {
+ public:
+  Builder(std::string f, std::string preview="");
+  void Run();
+  void Load(XwsList const &list);
+  std::vector<std::string> GetIssues() const;
+
+ private:
+  struct Attached {
+    std::string type; // xws slot key (ie. 'crew', 'amd')
+    Upgrade upgrade;
+  };
+  struct Ship {
+    Pilot pilot;
+    std::string pilotXws;
+    std::string shipXws;
+    std::vector<Attached> upgrades;
+    std::map<Upg, int> slots;   // slots the pilot has
+    std::map<Upg, int> used;    // slots filled
+    std::unordered_map<std::string, int> limited;
+    int choiceSlots;             // slots added by a title (ie. heavy scyk)...
+    std::vector<Upg> choiceTypes; // ...and the types they can hold
+  };
+
+  std::string faction;
+  std::string name;
+  std::string previewPath;
+  std::vector<Ship> ships;
+  std::unordered_map<std::string, Upgrade> upgradeIndex; // by "type/xws", filled as used
+  bool isRunning;
+  bool echo;
+  std::vector<std::string> loadIssues; // cards from Load that could not be added
+
+  // running counters
+  int cost;
+  std::unordered_map<std::string, int> uniques;
+  int uniqueDupes;  // extra copies of unique names
+  int limitedDupes; // extra copies of limited cards on a single ship
+  int slotsOver;    // upgrades without a free slot
+
+  Renderer render;
+
+  bool ParseCommand(std::string const &cmd);
+  bool AddShip(std::string const &shipXws, std::string const &pilotXws);
+  bool RemoveShip(size_t n);
+  bool AddUpgrade(size_t n, std::string const &type, std::string const &upgXws);
+  bool RemoveUpgrade(size_t n, std::string const &type, std::string const &upgXws);
+  int GetSlotsOver(Ship const &s) const;
+  void ApplyUpgrade(Ship &s, Upgrade &u, int delta);
+  void AddUnique(std::string const &n, int delta);
+  void PrintStatus() const;
+  void PrintList() const;
+  bool Save(std::string const &file) const;
+  void UpdatePreview();
+};
@@ -0,0 +1,100 @@
+#include "dice.h"
+#include <algorithm>
+
+static const double aHit   = (double)ATKHIT   / DIEFACES;
+static const double aCrit  = (double)ATKCRIT  / DIEFACES;
+static const double aFocus = (double)ATKFOCUS / DIEFACES;
+static const double dEvade = (double)DEFEVADE / DIEFACES;
+static const double dFocus = (double)DEFFOCUS / DIEFACES;
+
+typedef std::array<std::array<double, MAXDICE+1>, MAXDICE+1> HitCrit;
+typedef std::array<double, MAXDICE+2> Evades;
+
+// distribution of [hits][crits] for n attack dice
+static HitCrit RollAttack(int n, bool focus) {
+  double hit = aHit + (focus ? aFocus : 0);
+  double miss = 1.0 - hit - aCrit;
+  HitCrit cur = {};
+  cur[0][0] = 1.0;
+  for(int d=0; d<n; d++) {
+    HitCrit next = {};
+    for(int h=0; h<=d; h++) {
+      for(int c=0; h+c<=d; c++) {
+        if(cur[h][c] == 0) continue;
+        next[h+1][c] += cur[h][c] * hit;
+        next[h][c+1] += cur[h][c] * aCrit;
+        next[h][c]   += cur[h][c] * miss;
+      }
+    }
+    cur = next;
+  }
+  return cur;
+}
+
+// distribution of evades for n defense dice
+static Evades RollDefense(int n, bool focus, bool evade) {
+  double ev = dEvade + (focus ? dFocus : 0);
+  Evades cur = {};
+  cur[0] = 1.0;
+  for(int d=0; d<n; d++) {
+    Evades next = {};
+    for(int e=0; e<=d; e++) {
+      next[e+1] += cur[e] * ev;
+      next[e]   += cur[e] * (1.0 - ev);
+    }
+    cur = next;
+  }
+  if(evade) {
+    for(int e=MAXDICE+1; e>0; e--) { cur[e] = cur[e-1]; }
+    cur[0] = 0;
+  }
+  return cur;
+}
+
+void Dice::BuildTable(Table &table) {
+  for(int m=0; m<=static_cast<int>(DiceMod::All); m++) {
+    DiceMod mods = static_cast<DiceMod>(m);
+    for(int a=0; a<=MAXDICE; a++) {
+      HitCrit atk = RollAttack(a, mods & DiceMod::AtkFocus);
+      for(int g=0; g<=MAXDICE; g++) {
+        Evades def = RollDefense(g, mods & DiceMod::DefFocus, mods & DiceMod::DefEvade);
+        DiceOdds &o = table[m][a][g];
+        o = {};
+        for(int h=0; h<=a; h++) {
+          for(int c=0; h+c<=a; c++) {
+            if(atk[h][c] == 0) continue;
+            for(int e=0; e<=MAXDICE+1; e++) {
+              if(def[e] == 0) continue;
+              int hLeft = std::max(0, h-e);
+              int cLeft = std::max(0, c-std::max(0, e-h));
+              o.damage[hLeft][cLeft] += atk[h][c] * def[e];
+            }
+          }
+        }
+        for(int h=0; h<=MAXDICE; h++) {
+          for(int c=0; h+c<=MAXDICE; c++) {
+            o.hits  += o.damage[h][c] * h;
+            o.crits += o.damage[h][c] * c;
+            for(int n=0; n<=h+c; n++) {
+              o.atLeast[n] += o.damage[h][c];
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+const Dice::Table& Dice::GetTable() {
+  static const Table *table = [] { Table *t = new Table; BuildTable(*t); return t; }();
+  return *table;
+}
+
+const DiceOdds& Dice::GetOdds(uint8_t attack, uint8_t agility, DiceMod mods) {
+  return GetTable()[static_cast<int>(mods)][std::min<int>(attack, MAXDICE)][std::min<int>(agility, MAXDICE)];
+}
+
+double Dice::GetKillChance(uint8_t attack, uint8_t agility, DiceMod mods, uint8_t hp) {
+  if(hp > MAXDICE+1) return 0;
+  return GetOdds(attack, agility, mods).atLeast[hp];
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <stdint.h>
+
+// exact attack/defense dice odds.
+// every combination of attack dice, defense dice and token modifiers is
+// convolved once (on first use) so each lookup is just an index.
+
+const int MAXDICE = 8;
+
+// faces on the 8 sided dice
+const int DIEFACES  = 8;
+const int ATKHIT    = 3;
+const int ATKCRIT   = 1;
+const int ATKFOCUS  = 2; // the other 2 attack faces are blank
+const int DEFEVADE  = 3;
+const int DEFFOCUS  = 2; // the other 3 defense faces are blank
+
+enum class DiceMod : uint8_t {
+  None     = 0,
+  AtkFocus = 1, // attacker spends focus (focus -> hit)
+  DefFocus = 2, // defender spends focus (focus -> evade)
+  DefEvade = 4, // defender spends evade (+1 evade)
+  All      = 7
+};
+
+inline DiceMod operator|(DiceMod a, DiceMod b) { return static_cast<DiceMod>(static_cast<uint8_t>(a) | static_cast<uint8_t>(b)); }
+inline bool operator&(DiceMod a, DiceMod b) { return (static_cast<uint8_t>(a) & static_cast<uint8_t>(b)) != 0; }
+
+struct DiceOdds {
+  // probability of [hits][crits] getting through after evades cancel them (hits first)
+  std::array<std::array<double, MAXDICE+1>, MAXDICE+1> damage;
+  // probability of at least n total damage (hits + crits)
+  std::array<double, MAXDICE+2> atLeast;
+  double hits;  // expected uncancelled hits
+  double crits; // expected uncancelled crits
+};
+
+class Dice {
+ public:
+  static const DiceOdds& GetOdds(uint8_t attack, uint8_t agility, DiceMod mods);
+  // probability that the attack removes at least hp shields+hull (each hit and crit counted as 1)
+  static double GetKillChance(uint8_t attack, uint8_t agility, DiceMod mods, uint8_t hp);
+
+ private:
+  typedef std::array<std::array<std::array<DiceOdds, MAXDICE+1>, MAXDICE+1>, static_cast<int>(DiceMod::All)+1> Table;
+  static const Table& GetTable();
+  static void BuildTable(Table &table);
+};
@@ -1,28 +1,63 @@
 #include "game.h"
 #include "imagegen.h"
+#include "dice.h"
 #include <stdio.h>
 #include <cctype>
 #include <iostream>
+#include <algorithm>
 
-Game::Game(std::array<Squad, 2>& p, std::string op)
-  : players(p), outPath(op), isRunning(true) {
+// the first output is always 1080p; extra heights are added after it
+static std::vector<int> GetOutputHeights(std::vector<int> const &extra) {
+  std::vector<int> heights = { HEIGHT };
+  for(int h : extra) {
+    if(std::find(heights.begin(), heights.end(), h) == heights.end()) heights.push_back(h);
+  }
+  return heights;
+}
+
+Game::Game(std::array<Squad, 2>& p, std::string op, bool c, std::vector<int> const &extraHeights)
+  : players(p), text({{ SquadText(p[0]), SquadText(p[1]) }}), outPath(op), combined(c), showOdds(false), score(p),
+    render(c ? HUDWIDTH : WIDTH, c ? HUDHEIGHT : HEIGHT, GetOutputHeights(extraHeights)), isRunning(true) {
   if(this->outPath[this->outPath.length()-1] != '/') {
     this->outPath += "/";
   }
+  // p1.png for 1080p, p1-720.png etc for the rest
+  for(size_t i=0; i<this->render.GetOutputCount(); i++) {
+    std::string suffix = (i == 0) ? ".png" : "-" + std::to_string(this->render.GetHeight(i)) + ".png";
+    this->p1Files.push_back(this->outPath + "p1" + suffix);
+    this->p2Files.push_back(this->outPath + "p2" + suffix);
+    this->hudFiles.push_back(this->outPath + "hud" + suffix);
+  }
 }
 
 void Game::Run() {
-  GenerateImage(this->players[0], this->outPath+"p1.png");
-  GenerateImage(this->players[1], this->outPath+"p2.png");
+  this->Draw();
+  std::string line;
   do {
-    std::string line;
     printf("xhud> ");
     std::getline(std::cin, line);
-    if(this->ParseCommand(line)) {
-      GenerateImage(this->players[0], this->outPath+"/p1.png");
-      GenerateImage(this->players[1], this->outPath+"/p2.png");
-    }
-  } while(this->isRunning);
+  } while(this->Step(line));
+}
+
+bool Game::Step(std::string const &cmd) {
+  if(this->ParseCommand(cmd)) {
+    this->Draw();
+  }
+  return this->isRunning;
+}
+
+void Game::Draw() {
+  size_t outputs = this->render.GetOutputCount();
+  if(this->combined) {
+    this->UpdateOdds();
+    this->render.Render(this->players, this->text, this->score);
+    for(size_t i=0; i<outputs; i++) this->render.WritePng(this->hudFiles[i], i);
+  } else {
+    this->render.Render(this->players[0], this->text[0]);
+    for(size_t i=0; i<outputs; i++) this->render.WritePng(this->p1Files[i], i);
+    this->render.Render(this->players[1], this->text[1]);
+    for(size_t i=0; i<outputs; i++) this->render.WritePng(this->p2Files[i], i);
+  }
 }
 
 enum class PState {
@@ -39,7 +74,7 @@ struct PTarget {
 };
 
 // return is whether or not to redraw the images
-bool Game::ParseCommand(std::string cmd) {
+bool Game::ParseCommand(std::string const &cmd) {
 
   if(cmd == "qqq") {
     this->isRunning = false;
@@ -52,6 +87,8 @@ bool Game::ParseCommand(std::string cmd) {
     printf("  qqq    - quit\n");
     printf("  <PSC>  - modify ship stats\n");
     printf("  <PSUC> - modify upgrade status\n");
+    printf("  odds <PS> <PS>     - attack odds for first ship attacking second\n");
+    printf("  odds               - clear the odds readout\n");
     printf("   P - player number (1 or 2)\n");
     printf("   S - ship number (1..n counting down)\n");
     printf("   U - upgrade number (1..n left to right, top to bottom)\n");
@@ -68,8 +105,13 @@ bool Game::ParseCommand(std::string cmd) {
     printf("    11hhe   - player 1, ship 1 loses 2 hull and is disabled\n");
     printf("    231e    - player 2, ship 3, upgrade 1 is disabled\n");
     printf("    11h 12h - player 1, ships 1 and 2 each lose a hull\n");
+    printf("    odds 11 23 - player 1 ship 1 attacking player 2 ship 3\n");
     return false;
   }
+
+  if((cmd.compare(0, 4, "odds") == 0) && ((cmd.length() == 4) || (cmd[4] == ' '))) {
+    return this->ParseOdds(cmd);
+  }
   
   PState ps = PState::GetPlayer;
   PTarget pt;
@@ -97,18 +139,18 @@ bool Game::ParseCommand(std::string cmd) {
     case PState::GetShipCommand:
       if(isdigit(c)) {
 	pt.upgrade = c-48;
-	if((pt.upgrade < 1) || (pt.upgrade > this->players[pt.player-1].GetPilots()[pt.ship-1].GetAppliedUpgrades().size()+1)) {
+	if((pt.upgrade < 1) || (pt.upgrade > this->players[pt.player-1].GetPilots()[pt.ship-1].GetAppliedUpgrades().size())) {
 	  printf("Invalid upgrade\n");
 	  return false;
 	}
 	ps = PState::GetUpgradeCommand;
       } else {
-	std::string pn = this->players[pt.player-1].GetPilots()[pt.ship-1].GetPilotName();
+	std::string const &pn = this->text[pt.player-1].pilots[pt.ship-1].name;
 	switch(c) {
 	case 's': this->players[pt.player-1].GetPilots()[pt.ship-1].ShieldDn(); printf("  Player %d - Ship %d (%s) - Shield Down\n", pt.player, pt.ship, pn.c_str()); break;
 	case 'S': this->players[pt.player-1].GetPilots()[pt.ship-1].ShieldUp(); printf("  Player %d - Ship %d (%s) - Shield Up\n",   pt.player, pt.ship, pn.c_str()); break;
-	case 'h': this->players[pt.player-1].GetPilots()[pt.ship-1].HullDn();   printf("  Player %d - Ship %d (%s) - Hull Down\n",   pt.player, pt.ship, pn.c_str()); break;
-	case 'H': this->players[pt.player-1].GetPilots()[pt.ship-1].HullUp();   printf("  Player %d - Ship %d (%s) - Hull Up\n",     pt.player, pt.ship, pn.c_str()); break;
+	case 'h': this->players[pt.player-1].GetPilots()[pt.ship-1].HullDn();   printf("  Player %d - Ship %d (%s) - Hull Down\n",   pt.player, pt.ship, pn.c_str()); this->score.Update(pt.player-1, pt.ship-1); break;
+	case 'H': this->players[pt.player-1].GetPilots()[pt.ship-1].HullUp();   printf("  Player %d - Ship %d (%s) - Hull Up\n",     pt.player, pt.ship, pn.c_str()); this->score.Update(pt.player-1, pt.ship-1); break;
 	case 'e': this->players[pt.player-1].GetPilots()[pt.ship-1].Disable();  printf("  Player %d - Ship %d (%s) - Disabled\n",    pt.player, pt.ship, pn.c_str()); break;
 	case 'E': this->players[pt.player-1].GetPilots()[pt.ship-1].Enable();   printf("  Player %d - Ship %d (%s) - Enabled\n",     pt.player, pt.ship, pn.c_str()); break;
 	case ' ': ps = PState::GetPlayer;                                       break;
@@ -118,8 +160,8 @@ bool Game::ParseCommand(std::string cmd) {
       break;
 
     case PState::GetUpgradeCommand:
-      std::string pn = this->players[pt.player-1].GetPilots()[pt.ship-1].GetPilotName();
-      std::string un = this->players[pt.player-1].GetPilots()[pt.ship-1].GetAppliedUpgrades()[pt.upgrade-1].GetUpgradeName();
+      std::string const &pn = this->text[pt.player-1].pilots[pt.ship-1].name;
+      std::string const &un = this->text[pt.player-1].pilots[pt.ship-1].upgrades[pt.upgrade-1].name;
       switch(c) {
       case 'e':
 	this->players[pt.player-1].GetPilots()[pt.ship-1].GetAppliedUpgrades()[pt.upgrade-1].Disable();
@@ -139,3 +181,96 @@ bool Game::ParseCommand(std::string cmd) {
 
   return true;
 }
+
+
+
+static bool ParseShip(std::array<Squad, 2>& players, const char *s, size_t len, Game::ShipRef &ref) {
+  if(len != 2) return false;
+  if((s[0] < '1') || (s[0] > '2')) return false;
+  ref.player = s[0]-'1';
+  if((s[1] < '1') || ((size_t)(s[1]-'0') > players[ref.player].GetPilots().size())) return false;
+  ref.ship = s[1]-'1';
+  return true;
+}
+
+// return is whether or not to redraw the images
+bool Game::ParseOdds(std::string const &cmd) {
+  // split "odds PS PS" in place
+  const char *tok[3] = {0,0,0};
+  size_t len[3] = {0,0,0};
+  int n = 0;
+  for(size_t i=4; (i < cmd.length()) && (n < 3); ) {
+    if(cmd[i] == ' ') { i++; continue; }
+    tok[n] = &cmd[i];
+    while((i < cmd.length()) && (cmd[i] != ' ')) { len[n]++; i++; }
+    n++;
+  }
+
+  if(n == 0) {
+    this->showOdds = false;
+    this->score.SetCaption("");
+    return this->combined;
+  }
+
+  ShipRef at, dt;
+  if((n != 2) || !ParseShip(this->players, tok[0], len[0], at) || !ParseShip(this->players, tok[1], len[1], dt)) {
+    printf("Invalid ship\n");
+    return false;
+  }
+  if(at.player == dt.player) {
+    printf("Attacker and defender must be on different sides\n");
+    return false;
+  }
+
+  Pilot& attacker = this->players[at.player].GetPilots()[at.ship];
+  Pilot& defender = this->players[dt.player].GetPilots()[dt.ship];
+  uint8_t hp = defender.GetCurHull() + defender.GetCurShield();
+
+  printf("  %s (%d attack) -> %s (%d agility, %d hp)\n",
+         this->text[at.player].pilots[at.ship].name.c_str(), attacker.GetModAttack(),
+         this->text[dt.player].pilots[dt.ship].name.c_str(), defender.GetModAgility(), hp);
+  printf("    %-24s %6s %6s %6s\n", "", "hits", "crits", "kill");
+  std::pair<const char*, DiceMod> variants[] = {
+    { "no tokens",               DiceMod::None                                         },
+    { "attacker focus",          DiceMod::AtkFocus                                     },
+    { "defender focus",          DiceMod::DefFocus                                     },
+    { "defender evade",          DiceMod::DefEvade                                     },
+    { "both focus",              DiceMod::AtkFocus | DiceMod::DefFocus                 },
+    { "atk focus, def evade",    DiceMod::AtkFocus | DiceMod::DefEvade                 },
+    { "atk focus, def foc+evd",  DiceMod::AtkFocus | DiceMod::DefFocus | DiceMod::DefEvade },
+  };
+  for(auto v : variants) {
+    const DiceOdds &o = Dice::GetOdds(attacker.GetModAttack(), defender.GetModAgility(), v.second);
+    double kill = Dice::GetKillChance(attacker.GetModAttack(), defender.GetModAgility(), v.second, hp);
+    printf("    %-24s %6.2f %6.2f %5.1f%%\n", v.first, o.hits, o.crits, kill*100);
+  }
+
+  this->showOdds = true;
+  this->oddsAttacker = at;
+  this->oddsDefender = dt;
+  return this->combined;
+}
+
+// the readout follows the ships as they take damage, so it is rebuilt for
+// every frame rather than when the odds command was entered
+void Game::UpdateOdds() {
+  if(!this->showOdds) return;
+  Pilot& attacker = this->players[this->oddsAttacker.player].GetPilots()[this->oddsAttacker.ship];
+  Pilot& defender = this->players[this->oddsDefender.player].GetPilots()[this->oddsDefender.ship];
+  if((attacker.GetCurHull() == 0) || (defender.GetCurHull() == 0)) {
+    this->showOdds = false;
+    this->score.SetCaption("");
+    return;
+  }
+
+  // readout for the overlay uses the common case of both sides focused
+  uint8_t hp = defender.GetCurHull() + defender.GetCurShield();
+  DiceMod mods = DiceMod::AtkFocus | DiceMod::DefFocus;
+  const DiceOdds &o = Dice::GetOdds(attacker.GetModAttack(), defender.GetModAgility(), mods);
+  char caption[128];
+  snprintf(caption, sizeof(caption), "%s -> %s: %.1f dmg, %.0f%% kill",
+           this->text[this->oddsAttacker.player].pilots[this->oddsAttacker.ship].nameShort.c_str(),
+           this->text[this->oddsDefender.player].pilots[this->oddsDefender.ship].nameShort.c_str(),
+           o.hits + o.crits, Dice::GetKillChance(attacker.GetModAttack(), defender.GetModAgility(), mods, hp) * 100);
+  this->score.SetCaption(caption);
+}
@@ -1,18 +1,40 @@
 #pragma once
 //#include "xwinglist.h"
 #include "./libxwing/squad.h"
+#include "scoreboard.h"
+#include "imagegen.h"
 #include <array>
+#include <vector>
 
 
 
 class Game {
  public:
-  Game(std::array<Squad, 2>& p, std::string op);
+  Game(std::array<Squad, 2>& p, std::string op, bool c=false, std::vector<int> const &extraHeights={});
   void Run();
+  bool Step(std::string const &cmd); // one line of input, redrawing if needed. false once quit
+
+  struct ShipRef {
+    uint8_t player; // 0-based
+    uint8_t ship;   // 0-based
+  };
 
  private:
   std::array<Squad, 2>& players;
+  std::array<SquadText, 2> text;
   std::string outPath;
+  std::vector<std::string> p1Files;
+  std::vector<std::string> p2Files;
+  std::vector<std::string> hudFiles;
+  bool combined;
+  bool showOdds;
+  ShipRef oddsAttacker;
+  ShipRef oddsDefender;
+  Scoreboard score;
+  Renderer render;
   bool isRunning;
-  bool ParseCommand(std::string cmd);
+  bool ParseCommand(std::string const &cmd);
+  bool ParseOdds(std::string const &cmd);
+  void Draw();
+  void UpdateOdds();
 };
@@ -1,5 +1,7 @@
 #include "imagegen.h"
-#include <gd.h>
+#include <string.h>
+#include <algorithm>
+#include <stdexcept>
 
 //   fonts
 // title: BankGothic Md BT
@@ -10,9 +12,6 @@ const std::string shipsFont = "./fonts/xwing-miniatures-ships.ttf";
 const std::string titleFont = "./fonts/Bank Gothic Medium BT.ttf";
 const std::string statsFont = "./fonts/kimberley bl.ttf";
 
-static int WIDTH  =  381;
-static int HEIGHT = 1080;
-
 
 
 class Box {
@@ -38,33 +37,7 @@ private:
 
 
 
-struct ColorPalette {
-  // background
-  int bg;
-  // basics
-  int white;
-  int black;
-  // functions
-  int skill;
-  int attack;
-  int agility;
-  int hull;
-  int shield;
-  int hitHull;
-  int hitShield;
-  int upgrade;
-  // disabled functions
-  int skillD;
-  int attackD;
-  int agilityD;
-  int hullD;
-  int shieldD;
-  int hitHullD;
-  int hitShieldD;
-  int upgradeD;
-};
-
-static Box GetTextSize(std::string text, std::string font, double size) {
+static Box GetTextSize(const char *text, std::string const &font, double size) {
   // [0,1] lower-left  X,Y
   // [2,3] lower-right X,Y
   // [4,5] upper-right X,Y
@@ -78,52 +51,36 @@ static Box GetTextSize(std::string text, std::string font, double size) {
 			      0.0,       // angle
 			      0,         // x
 			      0,         // y
-			      (char*)text.c_str()); // string
+			      (char*)text); // string
   if(err) { printf("%s\n", err); return Box::FromTLBR(0,0,0,0); }
   return Box::FromTLBR(brect[7], brect[6], brect[3], brect[2]);
 }
 
 
 
-static Box DrawText(std::string text, std::string font, double size, gdImagePtr img, int color, int x, int y) {
-  int brect[8];
-  char *err = gdImageStringFT(img,       // img
-			      &brect[0], // rect
-			      color,     // color
-			      (char*)font.c_str(), // font
-			      size,      // size
-			      0.0,       // angle
-			      x,         // x
-			      y,         // y
-			      (char*)text.c_str()); // string
-  if(err) { printf("%s\n", err); return Box::FromTLBR(0,0,0,0); }
-  return Box::FromTLBR(brect[7], brect[6], brect[3], brect[2]);
-}
-
-static std::string GetNatModString(uint8_t nat, uint8_t mod) {
-  char s[8];
+static const char* GetNatModString(FrameArena &arena, uint8_t nat, uint8_t mod) {
   if(nat == mod) {
-    snprintf(s, sizeof(s), "%hhu", nat);
+    return arena.Printf("%hhu", nat);
   } else {
-    snprintf(s, sizeof(s), "%hhu(%hhu)", nat, mod);
+    return arena.Printf("%hhu(%hhu)", nat, mod);
   }
-  return s;
 }
 
-static int DrawPilot(gdImagePtr img, Pilot& pilot, int yOffset, ColorPalette const &colors) {
+static int DrawPilot(Layout &layout, Pilot& pilot, SquadText::PilotText &text, int xOffset, int yOffset, ColorPalette const &colors) {
+  FrameArena &arena = layout.GetArena();
   double skillFontSize = 20.0;
   double pilotFontSize = 20.0;
   double  costFontSize = 14.0;
   double statsFontSize = 20.0;
   double shipsFontSize = 26.0;
-  std::string shipString    = pilot.GetShipGlyph();
-  std::string pilotString   = pilot.GetPilotNameShort();
-  std::string costString    = std::to_string(pilot.GetModCost());
-  std::string skillString   = GetNatModString(pilot.GetNatSkill(), pilot.GetModSkill());
-  std::string attackString  = GetNatModString(pilot.GetNatAttack(), pilot.GetModAttack());
-  std::string agilityString = GetNatModString(pilot.GetNatAgility(), pilot.GetModAgility());
-  std::string hullString    = GetNatModString(pilot.GetNatHull(), pilot.GetModHull());
-  std::string shieldString  = GetNatModString(pilot.GetNatShield(), pilot.GetModShield());
+  std::string const &shipString  = text.ship;
+  std::string const &pilotString = text.nameShort;
+  const char *costString    = arena.Printf("%d", pilot.GetModCost());
+  const char *skillString   = GetNatModString(arena, pilot.GetNatSkill(), pilot.GetModSkill());
+  const char *attackString  = GetNatModString(arena, pilot.GetNatAttack(), pilot.GetModAttack());
+  const char *agilityString = GetNatModString(arena, pilot.GetNatAgility(), pilot.GetModAgility());
+  const char *hullString    = GetNatModString(arena, pilot.GetNatHull(), pilot.GetModHull());
+  const char *shieldString  = GetNatModString(arena, pilot.GetNatShield(), pilot.GetModShield());
   bool en = pilot.GetIsEnabled();
 
   // first we need to draw a box for this pilot.
@@ -142,60 +99,56 @@ static int DrawPilot(gdImagePtr img, Pilot& pilot, int yOffset, ColorPalette con
   int yHp   = yOffset + 60 + upgHeight + 5;
 
   // background transparent image to darken background
-  Box bsPilot = Box::FromTLWH(yName, 0, 381, pilotHeight);
-  gdImageFilledRectangle(img, bsPilot.Left(), bsPilot.Top(), bsPilot.Right(), bsPilot.Bottom(), colors.bg);
+  Box bsPilot = Box::FromTLWH(yName, xOffset, WIDTH, pilotHeight);
+  layout.Rect(bsPilot.Left(), bsPilot.Top(), bsPilot.Right(), bsPilot.Bottom(), colors.bg);
 
   // pilot
-  Box bsShip = Box::FromTLWH(yName, 10, 30, 31);
-  Box bsName = Box::FromTLWH(yName, 40, 310, 31); //GetTextSize(pilotString, titleFont, pilotFontSize);
-  DrawText(shipString, shipsFont, shipsFontSize, img, colors.white, bsShip.Left(), bsShip.Top()+25);
-  DrawText(pilotString, titleFont, pilotFontSize, img, colors.white, bsName.Left(), bsName.Top()+25);
+  Box bsShip = Box::FromTLWH(yName, xOffset+10, 30, 31);
+  Box bsName = Box::FromTLWH(yName, xOffset+40, 310, 31); //GetTextSize(pilotString, titleFont, pilotFontSize);
+  layout.Text(shipString.c_str(), shipsFont, shipsFontSize, colors.white, bsShip.Left(), bsShip.Top()+25);
+  layout.Text(pilotString.c_str(), titleFont, pilotFontSize, colors.white, bsName.Left(), bsName.Top()+25);
 
   // cost
   Box bsCost = GetTextSize(costString, statsFont, costFontSize);
-  DrawText(costString, statsFont, costFontSize, img, colors.skillD, 380-bsCost.Width(), yName+20);
+  layout.Text(costString, statsFont, costFontSize, colors.skillD, xOffset+380-bsCost.Width(), yName+20);
 
   // skill
-  Box bsSkill = Box::FromTLWH(yStat, 10, 60, 31);//GetTextSize(skillString, statsFont, skillFontSize);
-  DrawText(skillString, statsFont, skillFontSize, img, en?colors.skill:colors.skillD, bsSkill.Left(), bsSkill.Top()+25);
+  Box bsSkill = Box::FromTLWH(yStat, xOffset+10, 60, 31);//GetTextSize(skillString, statsFont, skillFontSize);
+  layout.Text(skillString, statsFont, skillFontSize, en?colors.skill:colors.skillD, bsSkill.Left(), bsSkill.Top()+25);
 
   // attack
-  Box bsAttack = Box::FromTLWH(yStat, 70, 50, 31); //GetTextSize(attackString, statsFont, statsFontSize);
-  DrawText(attackString, statsFont, statsFontSize, img, en?colors.attack:colors.attackD, bsAttack.Left(), bsAttack.Top()+25);
+  Box bsAttack = Box::FromTLWH(yStat, xOffset+70, 50, 31); //GetTextSize(attackString, statsFont, statsFontSize);
+  layout.Text(attackString, statsFont, statsFontSize, en?colors.attack:colors.attackD, bsAttack.Left(), bsAttack.Top()+25);
 
   // agility
-  Box bsAgility = Box::FromTLWH(yStat, 120, 50, 31); //GetTextSize(agilityString, statsFont, statsFontSize);
-  DrawText(agilityString, statsFont, statsFontSize, img, en?colors.agility:colors.agilityD, bsAgility.Left(), bsAgility.Top()+25);
+  Box bsAgility = Box::FromTLWH(yStat, xOffset+120, 50, 31); //GetTextSize(agilityString, statsFont, statsFontSize);
+  layout.Text(agilityString, statsFont, statsFontSize, en?colors.agility:colors.agilityD, bsAgility.Left(), bsAgility.Top()+25);
 
   // hull
-  Box bsHull = Box::FromTLWH(yStat, 170, 50, 31); //GetTextSize(hullString, statsFont, statsFontSize);
-  DrawText(hullString, statsFont, statsFontSize, img, en?colors.hull:colors.hullD, bsHull.Left(),  bsHull.Top()+25);
+  Box bsHull = Box::FromTLWH(yStat, xOffset+170, 50, 31); //GetTextSize(hullString, statsFont, statsFontSize);
+  layout.Text(hullString, statsFont, statsFontSize, en?colors.hull:colors.hullD, bsHull.Left(),  bsHull.Top()+25);
 
   // shield
-  Box bsShield = Box::FromTLWH(yStat, 220, 50, 31); //GetTextSize(shieldString, statsFont, statsFontSize);
-  DrawText(shieldString, statsFont, statsFontSize, img, en?colors.shield:colors.shieldD, bsShield.Left(), bsShield.Top()+25);
+  Box bsShield = Box::FromTLWH(yStat, xOffset+220, 50, 31); //GetTextSize(shieldString, statsFont, statsFontSize);
+  layout.Text(shieldString, statsFont, statsFontSize, en?colors.shield:colors.shieldD, bsShield.Left(), bsShield.Top()+25);
 
   // actions
-  std::string actionString;
-  ForEachAction(pilot.GetModActions(), [&actionString](Act a){
-      actionString += GetActGlyph(a);
-      actionString += " ";
-    });
-  actionString.pop_back();
-  DrawText(actionString, iconsFont, 12, img, colors.white, 275, yStat+19);
+  SquadText::SetActions(text, pilot.GetModActions());
+  layout.Text(text.actionString.c_str(), iconsFont, 12, colors.white, xOffset+275, yStat+19);
 
   // upgrades
   int uCount = 0;
-  for(auto u : pilot.GetAppliedUpgrades()) {
+  for(auto& u : pilot.GetAppliedUpgrades()) {
+    SquadText::UpgradeText const &ut = text.upgrades[uCount];
     int uRow = uCount / 2;
-    Box bsIcon = Box::FromTLWH(yUpg+(uRow*20), !(uCount%2) ? 5 : 190, 22, 21);
+    Box bsIcon = Box::FromTLWH(yUpg+(uRow*20), xOffset + (!(uCount%2) ? 5 : 190), 22, 21);
     Box bsText = Box::FromTLWH(yUpg+(uRow*20), bsIcon.Right()+2, 160, 21);
     bool en = true; //u.GetIsEnabled();
-    DrawText(GetUpgGlyph(u.GetType()).c_str(), iconsFont, 15, img, en ? colors.upgrade : colors.upgradeD, bsIcon.Left(), bsIcon.Top()+17);
-    DrawText(u.GetUpgradeNameShort().c_str(), titleFont, 14, img, en ? colors.upgrade : colors.upgradeD, bsText.Left(), bsText.Top()+17);
+    layout.Text(ut.glyph.c_str(), iconsFont, 15, en ? colors.upgrade : colors.upgradeD, bsIcon.Left(), bsIcon.Top()+17);
+    layout.Text(ut.nameShort.c_str(), titleFont, 14, en ? colors.upgrade : colors.upgradeD, bsText.Left(), bsText.Top()+17);
     if(!u.GetIsEnabled()) {
       int y = ((bsIcon.Top() + bsIcon.Bottom()) / 2) + 3;
-      gdImageLine(img, bsIcon.Left(), y, bsText.Right(), y, colors.white);
+      layout.Line(bsIcon.Left(), y, bsText.Right(), y, colors.white);
     }
     uCount++;
   }
@@ -206,13 +159,13 @@ static int DrawPilot(gdImagePtr img, Pilot& pilot, int yOffset, ColorPalette con
   int segments = pilot.GetModShield() + pilot.GetModHull();
   int segWidth =  hpWidth / segments;
   for(int i=0; i<pilot.GetModHull(); i++) {
-    Box dummyBox = Box::FromTLWH(yHp, (segWidth*i)+10+2, segWidth-4, 10);
-    gdImageFilledRectangle(img, dummyBox.Left(), dummyBox.Top(), dummyBox.Right(), dummyBox.Bottom(),
+    Box dummyBox = Box::FromTLWH(yHp, xOffset+(segWidth*i)+10+2, segWidth-4, 10);
+    layout.Rect(dummyBox.Left(), dummyBox.Top(), dummyBox.Right(), dummyBox.Bottom(),
 			   (i < (pilot.GetCurHull())) ? en?colors.hull:colors.hullD : en?colors.hitHull:colors.hitHullD);
   }
   for(int i=0; i<pilot.GetModShield(); i++) {
-    Box dummyBox = Box::FromTLWH(yHp, (pilot.GetModHull()*segWidth)+(segWidth*i)+10+2, segWidth-4, 10);
-    gdImageFilledRectangle(img, dummyBox.Left(), dummyBox.Top(), dummyBox.Right(), dummyBox.Bottom(),
+    Box dummyBox = Box::FromTLWH(yHp, xOffset+(pilot.GetModHull()*segWidth)+(segWidth*i)+10+2, segWidth-4, 10);
+    layout.Rect(dummyBox.Left(), dummyBox.Top(), dummyBox.Right(), dummyBox.Bottom(),
 			   (i < (pilot.GetCurShield())) ? en?colors.shield:colors.shieldD : en?colors.hitShield:colors.hitShieldD);
   }
 
@@ -221,21 +174,8 @@ static int DrawPilot(gdImagePtr img, Pilot& pilot, int yOffset, ColorPalette con
 
 
 
-void GenerateImage(Squad& squad, std::string name) {
-  gdImagePtr img;
-  FILE *out = fopen((name+".tmp").c_str(), "wb");
-  if(out == 0) {
-    printf("error opening file");
-    return;
-  }
-
-  // create the image
-  int yOffset = 0;
-  img = gdImageCreateTrueColor(WIDTH, HEIGHT);
-
-  // prep the color palette
+static void AllocateColors(gdImagePtr img, ColorPalette &colors) {
   // http://www.had2know.com/technology/rgb-to-gray-scale-converter.html
-  ColorPalette colors;
   colors.bg         = gdImageColorAllocateAlpha(img, 0, 0, 0, 32);
   colors.white      = gdImageColorAllocate(img, 255, 255, 255);
   colors.black      = gdImageColorAllocate(img,   0,   0,   0);
@@ -255,38 +195,321 @@ void GenerateImage(Squad& squad, std::string name) {
   colors.hitShieldD = gdImageColorAllocate(img,  49,  49,  49);
   colors.upgrade    = gdImageColorAllocate(img, 255, 255, 255);
   colors.upgradeD   = gdImageColorAllocate(img,  96,  96,  96);
+}
+
+
 
+static void DrawSquad(Layout &layout, Squad& squad, SquadText &text, int xOffset, ColorPalette const &colors) {
   // set transparent backgrounds
-  gdImageSaveAlpha(img, 1);
-  gdImageAlphaBlending(img, 0); // clear to enable transparent background
-  for(int i=0; i<WIDTH; i++) {
-    gdImageLine(img, i, 0, i, HEIGHT-1, colors.bg);
-  }
-  gdImageAlphaBlending(img, 1); // now that background is drawn, set this again to make fonts prettier
+  layout.Fill(xOffset, 0, xOffset+WIDTH-1, HEIGHT-1, colors.bg);
 
   // print title
-  Box boxTitle = Box::FromTLWH(5, 5, 370, 30);
-  gdImageFilledRectangle(img, boxTitle.Left(), boxTitle.Top(), boxTitle.Right(), boxTitle.Bottom(), colors.bg);
-  std::string titleText = squad.GetName();
+  Box boxTitle = Box::FromTLWH(5, xOffset+5, 370, 30);
+  layout.Rect(boxTitle.Left(), boxTitle.Top(), boxTitle.Right(), boxTitle.Bottom(), colors.bg);
+  std::string const &titleText = text.name;
   double titleSize = 16.0;
-  Box boxTitleText = GetTextSize(titleText, titleFont, titleSize);
+  Box boxTitleText = GetTextSize(titleText.c_str(), titleFont, titleSize);
   // do some checking here to make sure that boxTitleText fits withing boxTitle... eventually...
-  Box boxTitleFinal = Box::FromTLWH(boxTitle.Top()+7, (boxTitle.Width()-boxTitleText.Width())/2, boxTitleText.Width(), boxTitleText.Height());
-  DrawText(titleText, titleFont, titleSize, img, colors.white, boxTitleFinal.Left(), boxTitleFinal.Top() + boxTitleFinal.Height());
-  yOffset = 50;
+  Box boxTitleFinal = Box::FromTLWH(boxTitle.Top()+7, xOffset+(boxTitle.Width()-boxTitleText.Width())/2, boxTitleText.Width(), boxTitleText.Height());
+  layout.Text(titleText.c_str(), titleFont, titleSize, colors.white, boxTitleFinal.Left(), boxTitleFinal.Top() + boxTitleFinal.Height());
+  int yOffset = 50;
 
   // draw the pilots
+  size_t p = 0;
   for(auto& pilot : squad.GetPilots()) {
-    yOffset += DrawPilot(img, pilot, yOffset, colors);
+    yOffset += DrawPilot(layout, pilot, text.pilots[p++], xOffset, yOffset, colors);
     yOffset += 10;  // some space between pilots
   }
+}
 
-  // save the image
-  gdImagePng(img, out);
-  fclose(out);
-  rename((name+".tmp").c_str(), name.c_str());
 
-  // clean up
 
-  gdImageDestroy(img);  
+static void DrawScoreboard(Layout &layout, std::array<SquadText, 2> const &text, Scoreboard const &score, ColorPalette const &colors) {
+  FrameArena &arena = layout.GetArena();
+  int left  = WIDTH + 10;
+  int right = HUDWIDTH - WIDTH - 10;
+  int mid   = (left + right) / 2;
+  double nameSize  = 16.0;
+  double scoreSize = 36.0;
+  double restSize  = 14.0;
+
+  Box bsBoard = Box::FromTLBR(5, mid-300, 90, mid+300);
+  layout.Rect(bsBoard.Left(), bsBoard.Top(), bsBoard.Right(), bsBoard.Bottom(), colors.bg);
+
+  // destroyed points for each side meet in the middle
+  for(int i=0; i<2; i++) {
+    std::string const &nameText = text[i].name;
+    const char *scoreText = arena.Printf("%hu", score.GetDestroyed(i));
+    const char *restText  = arena.Printf("%hu / %hu", score.GetRemaining(i), score.GetTotal(i));
+    Box bsName  = GetTextSize(nameText.c_str(), titleFont, nameSize);
+    Box bsScore = GetTextSize(scoreText, statsFont, scoreSize);
+    Box bsRest  = GetTextSize(restText,  statsFont, restSize);
+    int xName  = (i==0) ? mid-20-bsName.Width()  : mid+20;
+    int xScore = (i==0) ? mid-20-bsScore.Width() : mid+20;
+    int xRest  = (i==0) ? mid-20-bsRest.Width()  : mid+20;
+    layout.Text(nameText.c_str(), titleFont, nameSize,  colors.white,  xName,  bsBoard.Top()+22);
+    layout.Text(scoreText, statsFont, scoreSize, colors.skill,  xScore, bsBoard.Top()+65);
+    layout.Text(restText,  statsFont, restSize,  colors.skillD, xRest,  bsBoard.Top()+82);
+  }
+  layout.Line(mid, bsBoard.Top()+10, mid, bsBoard.Bottom()-10, colors.white);
+
+  std::string const &captionText = score.GetCaption();
+  if(!captionText.empty()) {
+    double captionSize = 12.0;
+    Box bsCaption = GetTextSize(captionText.c_str(), titleFont, captionSize);
+    Box bsCaptionBg = Box::FromTLBR(bsBoard.Bottom()+5, mid-300, bsBoard.Bottom()+30, mid+300);
+    layout.Rect(bsCaptionBg.Left(), bsCaptionBg.Top(), bsCaptionBg.Right(), bsCaptionBg.Bottom(), colors.bg);
+    layout.Text(captionText.c_str(), titleFont, captionSize, colors.white, mid-(bsCaption.Width()/2), bsCaptionBg.Top()+18);
+  }
 }
+
+
+
+// gd writes the encoded image through one of these; it appends to a
+// vector so repeat encodes reuse whatever capacity is already there
+struct VectorCtx {
+  gdIOCtx ctx;
+  std::vector<uint8_t> *out;
+};
+
+static void VectorPutC(gdIOCtx *ctx, int c) {
+  ((VectorCtx*)ctx)->out->push_back((uint8_t)c);
+}
+
+static int VectorPutBuf(gdIOCtx *ctx, const void *buf, int len) {
+  std::vector<uint8_t> *out = ((VectorCtx*)ctx)->out;
+  out->insert(out->end(), (const uint8_t*)buf, (const uint8_t*)buf + len);
+  return len;
+}
+
+
+
+SquadText::SquadText(Squad &squad) : name(squad.GetName()) {
+  for(auto &p : squad.GetPilots()) {
+    PilotText pt;
+    pt.ship      = p.GetShipGlyph();
+    pt.name      = p.GetPilotName();
+    pt.nameShort = p.GetPilotNameShort();
+    for(auto &u : p.GetAppliedUpgrades()) {
+      pt.upgrades.push_back({ GetUpgGlyph(u.GetType()), u.GetUpgradeName(), u.GetUpgradeNameShort() });
+    }
+    pt.actions = Act::None;
+    pt.actionString = "";
+    SetActions(pt, p.GetModActions());
+    this->pilots.push_back(pt);
+  }
+}
+
+void SquadText::SetActions(PilotText &pt, Act actions) {
+  if((actions == pt.actions) && (pt.actionString != "")) return;
+  pt.actions = actions;
+  pt.actionString.clear();
+  ForEachAction(actions, [&pt](Act a){
+      if(pt.actionString != "") pt.actionString += " ";
+      pt.actionString += GetActGlyph(a);
+    });
+}
+
+
+
+Layout::Layout() : arena(ARENASIZE) {
+  this->ops.reserve(1024);
+}
+
+void Layout::Reset() {
+  this->ops.clear();
+  this->arena.Reset();
+}
+
+void Layout::Fill(int x1, int y1, int x2, int y2, int color) {
+  this->ops.push_back({ DrawOp::Kind::Fill, color, x1, y1, x2, y2, 0, 0, 0 });
+}
+
+void Layout::Rect(int x1, int y1, int x2, int y2, int color) {
+  this->ops.push_back({ DrawOp::Kind::Rect, color, x1, y1, x2, y2, 0, 0, 0 });
+}
+
+void Layout::Line(int x1, int y1, int x2, int y2, int color) {
+  this->ops.push_back({ DrawOp::Kind::Line, color, x1, y1, x2, y2, 0, 0, 0 });
+}
+
+// the text is copied so callers can pass temporaries
+void Layout::Text(const char *text, std::string const &font, double size, int color, int x, int y) {
+  this->ops.push_back({ DrawOp::Kind::Text, color, x, y, x, y, &font, size, this->arena.Printf("%s", text) });
+}
+
+// rects are scaled by their outer edges so neighbouring boxes still meet
+static void Rasterize(Layout const &layout, gdImagePtr img, double scale) {
+  auto S = [scale](int v) { return (int)(v * scale + 0.5); };
+  for(auto const &op : layout.GetOps()) {
+    switch(op.kind) {
+    case DrawOp::Kind::Fill:
+      gdImageAlphaBlending(img, 0);
+      gdImageFilledRectangle(img, S(op.x1), S(op.y1), S(op.x2+1)-1, S(op.y2+1)-1, op.color);
+      gdImageAlphaBlending(img, 1);
+      break;
+    case DrawOp::Kind::Rect:
+      gdImageFilledRectangle(img, S(op.x1), S(op.y1), S(op.x2+1)-1, S(op.y2+1)-1, op.color);
+      break;
+    case DrawOp::Kind::Line:
+      gdImageSetThickness(img, std::max(1, S(1)));
+      gdImageLine(img, S(op.x1), S(op.y1), S(op.x2), S(op.y2), op.color);
+      gdImageSetThickness(img, 1);
+      break;
+    case DrawOp::Kind::Text: {
+      int brect[8];
+      char *err = gdImageStringFT(img, &brect[0], op.color, (char*)op.font->c_str(), op.size * scale, 0.0, S(op.x1), S(op.y1), (char*)op.text);
+      if(err) { printf("%s\n", err); }
+      break;
+    }
+    }
+  }
+}
+
+
+
+Renderer::Renderer(int w, int h, std::vector<int> const &outHeights) : width(w), height(h), master(0) {
+  if((w <= 0) || (h <= 0)) {
+    throw std::invalid_argument("Invalid layout size " + std::to_string(w) + "x" + std::to_string(h));
+  }
+  if(outHeights.size() == 0) {
+    throw std::invalid_argument("No output heights given");
+  }
+  for(int oh : outHeights) {
+    if((oh <= 0) || ((int)(w * ((double)oh / h) + 0.5) <= 0)) {
+      throw std::invalid_argument("Invalid output height " + std::to_string(oh));
+    }
+  }
+
+  for(int oh : outHeights) {
+    Output o;
+    o.scale  = (double)oh / h;
+    o.width  = (int)(w * o.scale + 0.5);
+    o.height = oh;
+    o.img    = gdImageCreateTrueColor(o.width, o.height);
+    if(!o.img) {
+      for(auto &done : this->outputs) gdImageDestroy(done.img);
+      throw std::invalid_argument("Unable to create " + std::to_string(o.width) + "x" + std::to_string(o.height) + " image");
+    }
+    gdImageSaveAlpha(o.img, 1);
+    this->outputs.push_back(o);
+    if(o.height > this->outputs[this->master].height) this->master = this->outputs.size()-1;
+  }
+  // truecolor colors do not depend on the image so one palette covers every output
+  AllocateColors(this->outputs[0].img, this->colors);
+  this->clear = gdImageColorAllocateAlpha(this->outputs[0].img, 0, 0, 0, 127);
+}
+
+Renderer::~Renderer() {
+  for(auto &o : this->outputs) {
+    gdImageDestroy(o.img);
+  }
+}
+
+// the layout is drawn once, into the largest output, and the others are
+// scaled down from that. freetype only runs for one size per frame, and an
+// extra output costs a resample.
+void Renderer::Rasterize() {
+  Output &m = this->outputs[this->master];
+  gdImageAlphaBlending(m.img, 0);
+  gdImageFilledRectangle(m.img, 0, 0, m.width-1, m.height-1, this->clear);
+  gdImageAlphaBlending(m.img, 1);
+  ::Rasterize(this->layout, m.img, m.scale);
+  for(auto &o : this->outputs) {
+    if(&o == &m) continue;
+    // copy alpha as is rather than blending onto whatever was there
+    gdImageAlphaBlending(o.img, 0);
+    gdImageCopyResampled(o.img, m.img, 0, 0, 0, 0, o.width, o.height, m.width, m.height);
+    gdImageAlphaBlending(o.img, 1);
+  }
+}
+
+void Renderer::Render(Squad& squad) {
+  SquadText text(squad);
+  this->Render(squad, text);
+}
+
+void Renderer::Render(Squad& squad, SquadText &text) {
+  this->layout.Reset();
+  DrawSquad(this->layout, squad, text, 0, this->colors);
+  this->Rasterize();
+}
+
+void Renderer::Render(std::array<Squad, 2>& players, Scoreboard const &score) {
+  std::array<SquadText, 2> text = {{ SquadText(players[0]), SquadText(players[1]) }};
+  this->Render(players, text, score);
+}
+
+void Renderer::Render(std::array<Squad, 2>& players, std::array<SquadText, 2> &text, Scoreboard const &score) {
+  // everything between the squads stays see-through
+  this->layout.Reset();
+  DrawSquad(this->layout, players[0], text[0], 0, this->colors);
+  DrawSquad(this->layout, players[1], text[1], this->width-WIDTH, this->colors);
+  DrawScoreboard(this->layout, text, score, this->colors);
+  this->Rasterize();
+}
+
+void Renderer::GetRGBA(uint8_t *rgba, size_t out) const {
+  Output const &o = this->outputs[out];
+  // gd alpha is 0 (opaque) to 127 (transparent)
+  for(int y=0; y<o.height; y++) {
+    for(int x=0; x<o.width; x++) {
+      int c = gdImageTrueColorPixel(o.img, x, y);
+      *rgba++ = gdTrueColorGetRed(c);
+      *rgba++ = gdTrueColorGetGreen(c);
+      *rgba++ = gdTrueColorGetBlue(c);
+      *rgba++ = ((127 - gdTrueColorGetAlpha(c)) * 255) / 127;
+    }
+  }
+}
+
+void Renderer::GetRGBA(std::vector<uint8_t> &rgba, size_t out) const {
+  rgba.resize(this->outputs[out].width * this->outputs[out].height * 4);
+  this->GetRGBA(rgba.data(), out);
+}
+
+void Renderer::GetPng(std::vector<uint8_t> &png, size_t out) {
+  VectorCtx vc;
+  memset(&vc.ctx, 0, sizeof(vc.ctx));
+  vc.ctx.putC   = VectorPutC;
+  vc.ctx.putBuf = VectorPutBuf;
+  vc.out = &png;
+  png.clear();
+  gdImagePngCtx(this->outputs[out].img, &vc.ctx);
+}
+
+// write to a temp file and rename it over the target so whatever is watching
+// the image never picks up a partially written file
+bool Renderer::WritePng(std::string const &name, size_t out) {
+  this->GetPng(this->png, out);
+  this->tmpName.assign(name).append(".tmp");
+  FILE *f = fopen(this->tmpName.c_str(), "wb");
+  if(f == 0) {
+    printf("error opening file");
+    return false;
+  }
+  fwrite(this->png.data(), 1, this->png.size(), f);
+  fclose(f);
+  rename(this->tmpName.c_str(), name.c_str());
+  return true;
+}
+
+
+
+// the font cache keeps each face loaded after first use, so a long running
+// process only pays for opening the fonts once
+void PreloadFonts() {
+  gdFontCacheSetup();
+  for(auto f : { &iconsFont, &shipsFont, &titleFont, &statsFont }) {
+    GetTextSize("0", *f, 12.0);
+  }
+}
+
+
+
+void GenerateImage(Squad& squad, std::string name) {
+  Renderer r(WIDTH, HEIGHT);
+  r.Render(squad);
+  r.WritePng(name);
+}
+
@@ -1,5 +1,163 @@
 #pragma once
 #include "./libxwing/libxwing.h"
+#include "scoreboard.h"
+#include "arena.h"
+#include <gd.h>
+#include <array>
 #include <string>
+#include <vector>
 
+const int WIDTH  =  381;
+const int HEIGHT = 1080;
+
+const int HUDWIDTH  = 1920;
+const int HUDHEIGHT = 1080;
+
+const size_t ARENASIZE = 32768; // per frame text
+
+
+
+struct ColorPalette {
+  // background
+  int bg;
+  // basics
+  int white;
+  int black;
+  // functions
+  int skill;
+  int attack;
+  int agility;
+  int hull;
+  int shield;
+  int hitHull;
+  int hitShield;
+  int upgrade;
+  // disabled functions
+  int skillD;
+  int attackD;
+  int agilityD;
+  int hullD;
+  int shieldD;
+  int hitHullD;
+  int hitShieldD;
+  int upgradeD;
+};
+
+
+
+// one frame's drawing in 1080p pixels. the layout is worked out once per
+// render and then rasterized into each output at that output's scale.
+struct DrawOp {
+  enum class Kind : uint8_t { Fill, Rect, Line, Text };
+  Kind kind;
+  int color;
+  int x1, y1, x2, y2;       // text uses x1,y1 as its baseline origin
+  std::string const *font;
+  double size;
+  const char *text;          // lives in the layout's arena
+};
+
+class Layout {
+ public:
+  Layout();
+  void Reset();
+  void Fill(int x1, int y1, int x2, int y2, int color); // replaces pixels (no blending)
+  void Rect(int x1, int y1, int x2, int y2, int color);
+  void Line(int x1, int y1, int x2, int y2, int color);
+  void Text(const char *text, std::string const &font, double size, int color, int x, int y);
+  FrameArena& GetArena() { return this->arena; }
+  std::vector<DrawOp> const &GetOps() const { return this->ops; }
+
+ private:
+  std::vector<DrawOp> ops;
+  FrameArena arena;
+};
+
+
+
+// the strings libxwing hands back by value for one squad, looked up once so
+// drawing a frame or echoing a command does not build them all again.
+// pilots and upgrades must not be added or removed while it is in use.
+struct SquadText {
+  struct UpgradeText {
+    std::string glyph;
+    std::string name;
+    std::string nameShort;
+  };
+  struct PilotText {
+    std::string ship;
+    std::string name;
+    std::string nameShort;
+    std::vector<UpgradeText> upgrades;
+    Act actions;              // what actionString was built from
+    std::string actionString;
+  };
+
+  SquadText(Squad &squad);
+  static void SetActions(PilotText &pt, Act actions); // only rebuilds if they changed
+
+  std::string name;
+  std::vector<PilotText> pilots;
+};
+
+
+
+// owns one canvas per output resolution and can be rendered into over and
+// over. each render lays the frame out once, draws it into the largest
+// canvas and scales the others down from that, so an extra output costs a
+// resample rather than another pass of freetype. output is available as raw RGBA, encoded png
+// bytes, or a png file. canvases, layout and png buffer are kept between
+// renders so a reused renderer does not need to reallocate them.
+class Renderer {
+ public:
+  // outHeights are the heights to produce; widths keep the aspect of w x h.
+  // throws std::invalid_argument for an empty or bad size or if a canvas
+  // can not be created
+  Renderer(int w, int h, std::vector<int> const &outHeights);
+  Renderer(int w, int h) : Renderer(w, h, std::vector<int>{ h }) { }
+  ~Renderer();
+  Renderer(const Renderer&) = delete;
+  Renderer& operator=(const Renderer&) = delete;
+
+  size_t GetOutputCount()      const { return this->outputs.size(); }
+  int GetWidth(size_t out=0)   const { return this->outputs[out].width; }
+  int GetHeight(size_t out=0)  const { return this->outputs[out].height; }
+
+  // the overloads without a SquadText look the squad's text up from
+  // libxwing on every call. only the SquadText& ones render without
+  // allocating, so callers that draw the same squad repeatedly keep one.
+  // WIDTH x HEIGHT layout
+  void Render(Squad& squad);
+  void Render(Squad& squad, SquadText &text);
+  // HUDWIDTH x HUDHEIGHT layout
+  void Render(std::array<Squad, 2>& players, Scoreboard const &score);
+  void Render(std::array<Squad, 2>& players, std::array<SquadText, 2> &text, Scoreboard const &score);
+
+  void GetRGBA(uint8_t *rgba, size_t out=0) const;            // caller provides width*height*4 bytes
+  void GetRGBA(std::vector<uint8_t> &rgba, size_t out=0) const;
+  void GetPng(std::vector<uint8_t> &png, size_t out=0);       // replaces contents, keeps capacity
+  bool WritePng(std::string const &name, size_t out=0);
+
+ private:
+  struct Output {
+    double scale;
+    int width;
+    int height;
+    gdImagePtr img;
+  };
+  int width;
+  int height;
+  std::vector<Output> outputs;
+  size_t master; // the largest output, the only one drawn directly
+  ColorPalette colors;
+  int clear;
+  Layout layout;
+  std::vector<uint8_t> png;
+  std::string tmpName;
+  void Rasterize();
+};
+
+
+
+void PreloadFonts();
 void GenerateImage(Squad& list, std::string name);
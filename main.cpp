@@ -1,10 +1,20 @@
 #include "imagegen.h"
 #include "game.h"
+#include "sim.h"
+#include "server.h"
+#include "builder.h"
 #include <sys/stat.h>
+#include <dirent.h>
 #include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
 #include <algorithm>
 #include <fstream>
 #include <string.h>
+#include <errno.h>
+#include <thread>
 
 #define NORMAL "\x1B[0m"
 #define GRAY   "\e[0;37m"
@@ -18,6 +28,26 @@
 
 
 
+// range accepted for the extra output heights of 'run'
+static const int MINHEIGHT = 240;
+static const int MAXHEIGHT = 4320;
+
+// limits for 'simulate'
+static const long long MAXGAMES   = 1000000000000LL;
+static const long long MAXTHREADS = 256;
+
+static bool ParseHeight(const char *arg, int &h) {
+  char *end;
+  errno = 0;
+  long v = strtol(arg, &end, 10);
+  if((end == arg) || (*end != 0) || (errno != 0) || (v < MINHEIGHT) || (v > MAXHEIGHT)) {
+    printf("Invalid output height '%s' (must be %d..%d)\n\n", arg, MINHEIGHT, MAXHEIGHT);
+    return false;
+  }
+  h = v;
+  return true;
+}
+
 static void printOptions() {
     printf("Options:\n");
     printf("  check             - check for required files\n");;
@@ -28,7 +58,18 @@ static void printOptions() {
     printf("  dump {P} {F} {S}  - dump the specified pilot/faction/ship (xws keys)\n");
     printf("  verify (L)        - verify the list (L)\n");
     printf("  gen {L} {I}       - generate image (I) for the list (L)\n");
-    printf("  run {L1} {L2} {P} - run a game with the 2 specified lists, outputting images to the specified path\n");
+    printf("  serve             - stay resident and run gen/verify/dump for other xhud calls\n");
+    printf("  servebench {L} [N]- time N verify calls of (L) with and without the server\n");
+    printf("  renderbench {L} [N [H...]]\n");
+    printf("                    - time N renders of (L) into memory, as RGBA and as png, and what\n");
+    printf("                      height H costs as an extra output against a separate render\n");
+    printf("  build {F} [I]     - build a list for faction (F) (xws key), optionally keeping image (I) updated\n");
+    printf("  run {L1} {L2} {P} [combined] [H...]\n");
+    printf("                    - run a game with the 2 specified lists, outputting images to the specified path\n");
+    printf("                    - combined outputs a single 1920x1080 image (hud.png) with a scoreboard\n");
+    printf("                    - H adds another output height, %d..%d (ie. 720 1440 2160 -> p1-720.png...)\n", MINHEIGHT, MAXHEIGHT);
+    printf("  simulate {L1} {L2} [-n G] [-j T]\n");
+    printf("                    - simulate G games (default 100000) between the 2 lists on T (1..%lld) threads\n", MAXTHREADS);
 }
 
 
@@ -224,6 +265,109 @@ void PrintShip(std::string ship) {
 }
 
 
+static std::string AbsPath(std::string path) {
+  if(path.length() && path[0] == '/') return path;
+  char cwd[4096];
+  if(getcwd(cwd, sizeof(cwd)) == 0) return path;
+  return std::string(cwd) + "/" + path;
+}
+
+
+
+// the commands that can be handed off to 'xhud serve'
+static bool IsOneShot(std::vector<std::string> const &args) {
+  if(args.size() == 0) return false;
+  return ((args[0] == "dump")   && ((args.size() == 2) || (args.size() == 4))) ||
+         ((args[0] == "verify") &&  (args.size() == 2)) ||
+         ((args[0] == "gen")    &&  (args.size() == 3));
+}
+
+static void RunOneShot(std::vector<std::string> const &args, Renderer *render) {
+  if((args[0] == "dump") && (args.size() == 2)) {
+    Squad sq = Squad(args[1]);
+    sq.Dump();
+  }
+  else if(args[0] == "dump") {
+    Pilot::GetPilot(args[1], args[2], args[3]).Dump();
+  }
+  else if(args[0] == "verify") {
+    VerifyList(args[1]);
+  }
+  else if(args[0] == "gen") {
+    Squad sq = Squad(args[1]);
+    if(render) {
+      render->Render(sq);
+      render->WritePng(args[2]);
+    } else {
+      GenerateImage(sq, args[2]);
+    }
+  }
+}
+
+// average ms per run, or -1 if a run failed
+static double TimeRuns(int count, std::function<bool()> run) {
+  auto start = std::chrono::steady_clock::now();
+  for(int i=0; i<count; i++) {
+    if(!run()) return -1;
+  }
+  std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+  return count ? elapsed.count() / count : 0;
+}
+
+
+
+// loads every *_good.xws / *_bad.xws in dir into a Builder through add/up
+// and checks the builder's running counters agree with the name.
+static bool RunTestBuilderFiles(std::string dir) {
+  std::vector<std::string> files;
+  DIR *d = opendir(dir.c_str());
+  if(!d) {
+    printf("Unable to read '%s'\n", dir.c_str());
+    return false;
+  }
+  struct dirent *e;
+  while((e = readdir(d))) {
+    std::string f = e->d_name;
+    if((f.find("_good") != std::string::npos) || (f.find("_bad") != std::string::npos)) {
+      if((f.length() > 4) && (f.compare(f.length()-4, 4, ".xws") == 0)) files.push_back(f);
+    }
+  }
+  closedir(d);
+  std::sort(files.begin(), files.end());
+
+  int filelen = 0;
+  for(auto const &f : files) { if(f.length() > filelen) filelen = f.length(); }
+  int failed = 0;
+  for(auto const &f : files) {
+    bool expectGood = f.find("_good") != std::string::npos;
+    printf("  %-*s - ", filelen, f.c_str());
+    fflush(stdout);
+    try {
+      XwsList list = ReadXws(dir + "/" + f);
+      Builder b(list.faction);
+      b.Load(list);
+      std::vector<std::string> issues = b.GetIssues();
+      if((issues.size() == 0) == expectGood) {
+        printf("Ok\n");
+      } else {
+        printf("\e[1;31mFAILED\x1B[0m (expected %s)\n", expectGood ? "valid" : "invalid");
+        failed++;
+      }
+      for(auto const &i : issues) {
+        printf("    %s\n", i.c_str());
+      }
+    }
+    catch(std::invalid_argument e) {
+      printf("\e[1;31mEXCEPTION\x1B[0m\n    %s\n", e.what());
+      failed++;
+    }
+  }
+  printf("\n%zu lists, %d failed\n", files.size(), failed);
+  return failed == 0;
+}
+
+
+
 int main(int argc, char *argv[]) {
 
   if(argc == 1) {
@@ -249,6 +393,10 @@ int main(int argc, char *argv[]) {
     RunTestXwsFiles(argv[2]);
   }
 
+  else if((strcmp(argv[1], "buildtest") == 0) && (argc == 3)) {
+    return RunTestBuilderFiles(argv[2]) ? 0 : 1;
+  }
+
   else if(strcmp(argv[1], "ships") == 0) {
     printf("%-30s %-30s\n", "Name", "xws key");
     std::vector<std::string> done;
@@ -271,27 +419,163 @@ int main(int argc, char *argv[]) {
     }
   }
 
-  else if((strcmp(argv[1], "dump") == 0) && (argc==3)) {
-    Squad sq = Squad(argv[2]);
-    sq.Dump();
+  else if(IsOneShot(std::vector<std::string>(argv+1, argv+argc))) {
+    std::vector<std::string> args(argv+1, argv+argc);
+    // file args are resolved here since the server has its own working dir
+    if(args[0] != "dump" || args.size() == 2) {
+      for(size_t i=1; i<args.size(); i++) { args[i] = AbsPath(args[i]); }
+    }
+    ForwardResult fr = getenv("XHUD_NOSERVER") ? ForwardResult::NoServer : Forward(GetSocketPath(), args);
+    if(fr == ForwardResult::NoServer) {
+      RunOneShot(args, 0);
+    }
+    else if(fr == ForwardResult::Failed) {
+      return 1;
+    }
   }
 
-  else if((strcmp(argv[1], "dump") == 0) && (argc==5)) {
-    Pilot::GetPilot(argv[2], argv[3], argv[4]).Dump();
+  else if((strcmp(argv[1], "serve") == 0) && (argc==2)) {
+    printf("Loading catalog and fonts...\n");
+    Pilot::GetAllPilots();
+    Upgrade::GetAllUpgrades();
+    PreloadFonts();
+    Renderer render(WIDTH, HEIGHT);
+    return Serve(GetSocketPath(), [&render](std::vector<std::string> const &args) {
+        if(!IsOneShot(args)) {
+          printf("Unsupported command\n");
+          return;
+        }
+        RunOneShot(args, &render);
+      }) ? 0 : 1;
+  }
+
+  else if((strcmp(argv[1], "servebench") == 0) && ((argc==3) || (argc==4))) {
+    int count = (argc==4) ? atoi(argv[3]) : 100;
+    std::vector<std::string> args = { "verify", AbsPath(argv[2]) };
+    int devnull = open("/dev/null", O_WRONLY);
+
+    printf("Cold process (%d runs)... ", count);
+    fflush(stdout);
+    double cold = TimeRuns(count, [&]() {
+        pid_t pid = fork();
+        if(pid == 0) {
+          dup2(devnull, 1);
+          setenv("XHUD_NOSERVER", "1", 1);
+          execl("/proc/self/exe", argv[0], "verify", args[1].c_str(), (char*)0);
+          execl(argv[0], argv[0], "verify", args[1].c_str(), (char*)0);
+          _exit(1);
+        }
+        waitpid(pid, 0, 0);
+        return pid > 0;
+      });
+    if(cold < 0) { printf("FAILED\n"); } else { printf("%8.3f ms/request\n", cold); }
+
+    printf("Server    (%d runs)... ", count);
+    fflush(stdout);
+    double warm = TimeRuns(count, [&]() { return Forward(GetSocketPath(), args, devnull) == ForwardResult::Done; });
+    if(warm < 0) { printf("no server running (start one with 'xhud serve')\n"); } else { printf("%8.3f ms/request\n", warm); }
+    close(devnull);
   }
 
+  else if((strcmp(argv[1], "renderbench") == 0) && (argc>=3)) {
+    int count = (argc>=4) ? atoi(argv[3]) : 100;
+    std::vector<int> heights;
+    for(int i=4; i<argc; i++) {
+      int h;
+      if(!ParseHeight(argv[i], h)) {
+        printOptions();
+        return 1;
+      }
+      heights.push_back(h);
+    }
+    try {
+      Squad sq = Squad(argv[2]);
+      PreloadFonts();
+      Renderer render(WIDTH, HEIGHT);
+      SquadText text(sq);
+      std::vector<uint8_t> rgba;
+      std::vector<uint8_t> png;
+
+      printf("Render    (%d runs)... ", count);
+      fflush(stdout);
+      printf("%8.3f ms/frame\n", TimeRuns(count, [&]() { render.Render(sq, text); return true; }));
+      printf("RGBA      (%d runs)... ", count);
+      fflush(stdout);
+      printf("%8.3f ms/frame\n", TimeRuns(count, [&]() { render.GetRGBA(rgba); return true; }));
+      printf("PNG       (%d runs)... ", count);
+      fflush(stdout);
+      printf("%8.3f ms/frame (%zu bytes)\n", TimeRuns(count, [&]() { render.GetPng(png); return true; }), png.size());
+
+      // an extra output against rendering that height on its own
+      double base = TimeRuns(count, [&]() { render.Render(sq, text); return true; });
+      for(int h : heights) {
+        Renderer both(WIDTH, HEIGHT, { HEIGHT, h });
+        Renderer alone(WIDTH, HEIGHT, { h });
+        double withExtra = TimeRuns(count, [&]() { both.Render(sq, text); return true; });
+        double separate  = TimeRuns(count, [&]() { alone.Render(sq, text); return true; });
+        printf("%4dp     (%d runs)... %8.3f ms as an extra output, %8.3f ms as a separate render\n",
+               h, count, withExtra - base, separate);
+      }
+    }
+    catch(std::invalid_argument ia) {
+      printf("Error: %s\n", ia.what());
+      return 1;
+    }
+  }
 
-  else if((strcmp(argv[1], "verify") == 0) && (argc==3)) {
-    VerifyList(argv[2]);
+  else if((strcmp(argv[1], "build") == 0) && ((argc==3) || (argc==4))) {
+    Builder b(argv[2], (argc==4) ? argv[3] : "");
+    b.Run();
   }
 
-  else if((strcmp(argv[1], "gen") == 0) && (argc==4)) {
-    Squad sq = Squad(argv[2]);
-    GenerateImage(sq, argv[3]);
+  else if((strcmp(argv[1], "simulate") == 0) && (argc>=4)) {
+    uint64_t games = 100000;
+    unsigned threads = std::min<unsigned>(std::thread::hardware_concurrency(), MAXTHREADS);
+    for(int i=4; i<argc; i++) {
+      bool isGames = strcmp(argv[i], "-n") == 0;
+      if((!isGames && (strcmp(argv[i], "-j") != 0)) || (i+1 >= argc)) { printOptions(); return 1; }
+      const char *arg = argv[++i];
+      long long max = isGames ? MAXGAMES : MAXTHREADS;
+      char *end;
+      errno = 0;
+      long long v = strtoll(arg, &end, 10);
+      if((end == arg) || (*end != 0) || (errno != 0) || (v < 1) || (v > max)) {
+        printf("Invalid %s '%s' (must be 1..%lld)\n\n", isGames ? "game count" : "thread count", arg, max);
+        printOptions();
+        return 1;
+      }
+      if(isGames) { games = v; } else { threads = v; }
+    }
+    try {
+      std::array<Squad, 2> players = { { Squad(argv[2]), Squad(argv[3]) } };
+      SimResult r = Simulate(players, games, threads);
+      printf("Games:   %llu on %u threads in %.2fs (%.0f games/sec)\n",
+             (unsigned long long)r.games, threads ? threads : 1, r.seconds, r.seconds > 0 ? r.games / r.seconds : 0);
+      for(int i=0; i<2; i++) {
+        printf("Player %d - %-30s wins %6.2f%%  avg surviving points %.1f\n", i+1, players[i].GetName().c_str(),
+               r.games ? 100.0 * r.wins[i] / r.games : 0, r.survivingPoints[i]);
+      }
+      printf("Draws:   %6.2f%%\n", r.games ? 100.0 * r.draws / r.games : 0);
+    }
+    catch(std::invalid_argument ia) {
+      printf("Error: %s\n", ia.what());
+      return 1;
+    }
   }
 
-  else if((strcmp(argv[1], "run") == 0) && (argc==5)) {
+  else if((strcmp(argv[1], "run") == 0) && (argc>=5)) {
     bool cannotPlay = false;
+    bool combined = false;
+    std::vector<int> heights;
+    for(int i=5; i<argc; i++) {
+      if(strcmp(argv[i], "combined") == 0) { combined = true; continue; }
+      int h;
+      if(!ParseHeight(argv[i], h)) {
+        printOptions();
+        return 1;
+      }
+      heights.push_back(h);
+    }
     std::string f1 = argv[2];
     std::string f2 = argv[3];
     std::string outpath = argv[4];
@@ -370,11 +654,11 @@ int main(int argc, char *argv[]) {
     printf("Running game...\n");
     try{
       std::array<Squad, 2> players = { { Squad(f1), Squad(f2) } };
-      Game g = Game(players, outpath);
+      Game g(players, outpath, combined, heights);
       g.Run();
     }
     catch(std::invalid_argument ia) {
-      printf("Error loading list '%s'\n", ia.what());
+      printf("Error: %s\n", ia.what());
       return 1;
     }
   }
@@ -0,0 +1,38 @@
+#include "scoreboard.h"
+
+Scoreboard::Scoreboard(std::array<Squad, 2>& p)
+  : players(p), totalLost({{0,0}}), total({{0,0}}) {
+  this->caption.reserve(128);
+  for(int i=0; i<2; i++) {
+    for(auto& pilot : this->players[i].GetPilots()) {
+      uint16_t l = GetLost(pilot);
+      this->lost[i].push_back(l);
+      this->totalLost[i] += l;
+      this->total[i] += pilot.GetModCost();
+    }
+  }
+}
+
+// a ship is worth its full cost (pilot + upgrades) once its hull is gone
+uint16_t Scoreboard::GetLost(Pilot& pilot) {
+  return (pilot.GetCurHull() == 0) ? pilot.GetModCost() : 0;
+}
+
+void Scoreboard::Update(uint8_t player, uint8_t ship) {
+  uint16_t l = GetLost(this->players[player].GetPilots()[ship]);
+  this->totalLost[player] -= this->lost[player][ship];
+  this->totalLost[player] += l;
+  this->lost[player][ship] = l;
+}
+
+uint16_t Scoreboard::GetDestroyed(uint8_t player) const {
+  return this->totalLost[player ? 0 : 1];
+}
+
+uint16_t Scoreboard::GetRemaining(uint8_t player) const {
+  return this->total[player] - this->totalLost[player];
+}
+
+uint16_t Scoreboard::GetTotal(uint8_t player) const {
+  return this->total[player];
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "./libxwing/squad.h"
+#include <array>
+#include <string>
+#include <vector>
+
+// running totals for the center scoreboard of the combined hud.
+// each pilot's contribution is cached so a command only has to touch
+// the pilot it changed instead of rescanning both squads.
+class Scoreboard {
+ public:
+  Scoreboard(std::array<Squad, 2>& p);
+  void Update(uint8_t player, uint8_t ship); // 0-based
+  uint16_t GetDestroyed(uint8_t player) const; // points destroyed BY this player
+  uint16_t GetRemaining(uint8_t player) const; // points this player has left on the table
+  uint16_t GetTotal(uint8_t player) const;
+  void SetCaption(const char *c) { this->caption.assign(c); } // extra line under the score (ie. odds readout)
+  std::string const &GetCaption() const { return this->caption; }
+
+ private:
+  std::array<Squad, 2>& players;
+  std::array<std::vector<uint16_t>, 2> lost; // points lost per pilot
+  std::array<uint16_t, 2> totalLost;
+  std::array<uint16_t, 2> total;
+  std::string caption;
+  static uint16_t GetLost(Pilot& pilot);
+};
@@ -0,0 +1,247 @@
+#include "server.h"
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <exception>
+
+// a request is the number of args then the args themselves, each
+// terminated by a '\0' (ie. "2\0verify\0/path/list.xws\0"), so the server
+// knows when it has all of it. the reply is the command's output followed
+// by '\0' and a status ('0' ok, '1' the command failed), so the client can
+// tell a finished reply from a server that dropped it or died.
+// both ends only talk to a peer running as the same user.
+
+static const size_t MAXREQUEST    = 65536;
+static const int    IOTIMEOUT     = 5;  // seconds a client may stall the server
+static const int    REPLYTIMEOUT  = 30; // seconds the server may stall a client
+
+// $XDG_RUNTIME_DIR is already private to the user. without it we use our
+// own dir in /tmp, which must be a real dir owned by us that nobody else
+// can get into. returns "" if that can not be had.
+std::string GetSocketPath() {
+  const char *runtime = getenv("XDG_RUNTIME_DIR");
+  if(runtime && (runtime[0] == '/')) {
+    return std::string(runtime) + "/xhud.sock";
+  }
+
+  std::string dir = "/tmp/xhud-" + std::to_string(getuid());
+  if((mkdir(dir.c_str(), 0700) != 0) && (errno != EEXIST)) return "";
+  struct stat s;
+  if((lstat(dir.c_str(), &s) != 0) || !S_ISDIR(s.st_mode) || (s.st_uid != getuid()) || (s.st_mode & 077)) {
+    return "";
+  }
+  return dir + "/xhud.sock";
+}
+
+static bool GetPeerUid(int fd, uid_t &uid) {
+#ifdef SO_PEERCRED
+  struct ucred cred;
+  socklen_t len = sizeof(cred);
+  if(getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0) return false;
+  uid = cred.uid;
+  return true;
+#else
+  gid_t gid;
+  return getpeereid(fd, &uid, &gid) == 0;
+#endif
+}
+
+static bool IsSameUser(int fd) {
+  uid_t uid;
+  return GetPeerUid(fd, uid) && (uid == getuid());
+}
+
+static bool MakeAddr(std::string const &sockPath, sockaddr_un &addr) {
+  if((sockPath.length() == 0) || (sockPath.length() >= sizeof(addr.sun_path))) return false;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, sockPath.c_str(), sizeof(addr.sun_path)-1);
+  return true;
+}
+
+static int Connect(std::string const &sockPath) {
+  sockaddr_un addr;
+  if(!MakeAddr(sockPath, addr)) return -1;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(fd < 0) return -1;
+  if((connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) || !IsSameUser(fd)) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static bool WriteAll(int fd, const char *buf, size_t len) {
+  while(len > 0) {
+    ssize_t n = write(fd, buf, len);
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return false;
+    buf += n;
+    len -= n;
+  }
+  return true;
+}
+
+// reads one framed request. false if the client sent too much, closed
+// early or stalled past IOTIMEOUT
+static bool ReadRequest(int fd, std::string &req, std::vector<std::string> &args) {
+  req.clear();
+  args.clear();
+  long count = -1;
+  size_t start = 0;
+  char buf[4096];
+  while((count < 0) || (args.size() < (size_t)count)) {
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if(n < 0 && errno == EINTR) continue;
+    if(n <= 0) return false;
+    req.append(buf, n);
+    if(req.length() > MAXREQUEST) return false;
+    for(size_t i=req.find('\0', start); i != std::string::npos; i=req.find('\0', start)) {
+      if(count < 0) {
+        char *end;
+        count = strtol(req.c_str()+start, &end, 10);
+        if((end != req.c_str()+i) || (count < 0)) return false;
+      } else {
+        args.push_back(req.substr(start, i-start));
+      }
+      start = i+1;
+    }
+  }
+  return start == req.length();
+}
+
+
+
+bool Serve(std::string const &sockPath, ServeHandler handler) {
+  sockaddr_un addr;
+  if(!MakeAddr(sockPath, addr)) {
+    printf("Unusable socket path: '%s'\n", sockPath.c_str());
+    return false;
+  }
+
+  // a socket file nobody answers on is left over from a dead server
+  int existing = Connect(sockPath);
+  if(existing >= 0) {
+    close(existing);
+    printf("Server already running on %s\n", sockPath.c_str());
+    return false;
+  }
+  unlink(sockPath.c_str());
+
+  // the socket is never usable by anyone else, even before the chmod
+  int lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t oldMask = umask(077);
+  bool bound = (lfd >= 0) && (bind(lfd, (sockaddr*)&addr, sizeof(addr)) == 0);
+  umask(oldMask);
+  if(!bound || (chmod(sockPath.c_str(), 0600) != 0) || (listen(lfd, 16) != 0)) {
+    printf("Unable to listen on %s: %s\n", sockPath.c_str(), strerror(errno));
+    if(lfd >= 0) close(lfd);
+    return false;
+  }
+
+  // a client that goes away mid-reply should not take the server with it
+  signal(SIGPIPE, SIG_IGN);
+  printf("Listening on %s\n", sockPath.c_str());
+  fflush(stdout);
+
+  int savedOut = dup(1);
+  std::string req;
+  std::vector<std::string> args;
+  for(;;) {
+    int cfd = accept(lfd, 0, 0);
+    if(cfd < 0) {
+      if(errno == EINTR) continue;
+      break;
+    }
+
+    if(!IsSameUser(cfd)) {
+      close(cfd);
+      continue;
+    }
+
+    // a client that stops reading or writing gets dropped rather than
+    // holding up everyone behind it
+    struct timeval tv = { IOTIMEOUT, 0 };
+    setsockopt(cfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(cfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    if(!ReadRequest(cfd, req, args)) {
+      close(cfd);
+      continue;
+    }
+
+    // point stdout at the client for the duration of the command
+    fflush(stdout);
+    dup2(cfd, 1);
+    char status[2] = { 0, '0' };
+    try {
+      if(args.size() > 0) handler(args);
+    }
+    catch(std::exception &e) {
+      printf("Error: %s\n", e.what());
+      status[1] = '1';
+    }
+    fflush(stdout);
+    dup2(savedOut, 1);
+    WriteAll(cfd, status, sizeof(status));
+    close(cfd);
+  }
+
+  close(savedOut);
+  close(lfd);
+  unlink(sockPath.c_str());
+  return false;
+}
+
+
+
+ForwardResult Forward(std::string const &sockPath, std::vector<std::string> const &args, int outFd) {
+  int fd = Connect(sockPath);
+  if(fd < 0) return ForwardResult::NoServer;
+  struct timeval tv = { REPLYTIMEOUT, 0 };
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+  std::string req = std::to_string(args.size());
+  req += '\0';
+  for(auto const &a : args) {
+    req += a;
+    req += '\0';
+  }
+  if(!WriteAll(fd, req.data(), req.length())) {
+    close(fd);
+    return ForwardResult::NoServer;
+  }
+
+  // output is passed on as it comes, holding back the last 2 bytes until
+  // it is known whether they are the status
+  std::string tail;
+  bool wrote = false;
+  char buf[4096];
+  ssize_t n;
+  while(((n = read(fd, buf, sizeof(buf))) > 0) || ((n < 0) && (errno == EINTR))) {
+    if(n <= 0) continue;
+    tail.append(buf, n);
+    if(tail.length() > 2) {
+      WriteAll(outFd, tail.data(), tail.length()-2);
+      tail.erase(0, tail.length()-2);
+      wrote = true;
+    }
+  }
+  close(fd);
+
+  if((tail.length() == 2) && (tail[0] == 0)) {
+    return (tail[1] == '0') ? ForwardResult::Done : ForwardResult::Failed;
+  }
+  // nothing was shown yet so the caller can still run it itself
+  if(!wrote) return ForwardResult::NoServer;
+  WriteAll(outFd, tail.data(), tail.length());
+  fprintf(stderr, "\nxhud server stopped before finishing the reply\n");
+  return ForwardResult::Failed;
+}
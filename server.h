@@ -0,0 +1,27 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+// keeps one xhud process warm (catalog, fonts, glyph cache) and runs
+// one-shot commands for other xhud processes over a unix socket.
+// anything the handler prints to stdout goes back to the client.
+// only processes running as the same user are served or forwarded to.
+
+typedef std::function<void(std::vector<std::string> const &args)> ServeHandler;
+
+// $XDG_RUNTIME_DIR/xhud.sock, else /tmp/xhud-<uid>/xhud.sock in a private
+// 0700 dir. "" if neither is safe to use.
+std::string GetSocketPath();
+
+// blocks forever serving requests. returns false if it could not listen.
+bool Serve(std::string const &sockPath, ServeHandler handler);
+
+enum class ForwardResult {
+  NoServer, // nothing was shown, the caller should run the command itself
+  Done,
+  Failed    // the command failed or the reply was cut short
+};
+
+// hands the command to a running server, copying its output to outFd.
+ForwardResult Forward(std::string const &sockPath, std::vector<std::string> const &args, int outFd=1);
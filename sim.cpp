@@ -0,0 +1,259 @@
+#include "sim.h"
+#include "dice.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+const int      MAXSHIPS  = 16;
+const int      MAXROUNDS = 12;
+const uint64_t CHUNK     = 1024;
+
+
+
+// ship stats laid out as parallel arrays, sorted by pilot skill (highest first)
+struct Fleet {
+  uint8_t  count;
+  uint8_t  side[MAXSHIPS];
+  uint8_t  skill[MAXSHIPS];
+  uint8_t  attack[MAXSHIPS];
+  uint8_t  agility[MAXSHIPS];
+  uint8_t  hull[MAXSHIPS];
+  uint8_t  shield[MAXSHIPS];
+  uint16_t cost[MAXSHIPS];
+  std::array<uint16_t, 2> total;
+};
+
+// per-game mutable state
+struct Battle {
+  uint8_t hull[MAXSHIPS];
+  uint8_t shield[MAXSHIPS];
+};
+
+static Fleet BuildFleet(std::array<Squad, 2>& players) {
+  struct Ship { uint8_t side; Pilot *pilot; };
+  std::vector<Ship> ships;
+  for(uint8_t s=0; s<2; s++) {
+    for(auto& p : players[s].GetPilots()) {
+      ships.push_back({s, &p});
+    }
+  }
+  if(ships.size() > MAXSHIPS) {
+    throw std::invalid_argument("Too many ships to simulate");
+  }
+  std::stable_sort(ships.begin(), ships.end(), [](Ship a, Ship b) { return a.pilot->GetModSkill() > b.pilot->GetModSkill(); });
+
+  Fleet f = {};
+  f.count = ships.size();
+  for(int i=0; i<f.count; i++) {
+    Pilot &p = *ships[i].pilot;
+    f.side[i]    = ships[i].side;
+    f.skill[i]   = p.GetModSkill();
+    f.attack[i]  = p.GetModAttack();
+    f.agility[i] = p.GetModAgility();
+    f.hull[i]    = p.GetModHull();
+    f.shield[i]  = p.GetModShield();
+    f.cost[i]    = p.GetModCost();
+    f.total[f.side[i]] += f.cost[i];
+  }
+  return f;
+}
+
+
+
+// counter based rng - every game gets its own stream keyed by its index so
+// results do not depend on which thread ran it
+class Rng {
+ public:
+  Rng(uint64_t k) : key(k), counter(0), bits(0), left(0) { }
+  // one 8 sided die
+  uint8_t Die() {
+    if(left == 0) {
+      bits = Mix(key + (++counter * 0x9E3779B97F4A7C15ULL));
+      left = 21;
+    }
+    uint8_t d = bits & 7;
+    bits >>= 3;
+    left--;
+    return d;
+  }
+
+ private:
+  uint64_t key;
+  uint64_t counter;
+  uint64_t bits;
+  uint8_t  left;
+  static uint64_t Mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+  }
+};
+
+static_assert(DIEFACES == 8, "Rng::Die() rolls 3 bits per die");
+
+// both sides are assumed to have focus, so focus faces count as hits/evades
+static int RollAttack(Rng &rng, uint8_t attack, uint8_t agility) {
+  int hits = 0;
+  for(int i=0; i<attack;  i++) { if(rng.Die() < ATKHIT + ATKCRIT + ATKFOCUS) hits++; }
+  for(int i=0; i<agility; i++) { if(rng.Die() < DEFEVADE + DEFFOCUS) hits--; }
+  return std::max(0, hits);
+}
+
+// returns winning side, or 2 for a draw
+static int PlayGame(Fleet const &f, Rng &rng, std::array<uint16_t, 2> &left) {
+  Battle b;
+  std::copy(f.hull,   f.hull+f.count,   b.hull);
+  std::copy(f.shield, f.shield+f.count, b.shield);
+  std::array<uint8_t, 2> alive = {{0,0}};
+  for(int i=0; i<f.count; i++) alive[f.side[i]]++;
+
+  for(int round=0; round<MAXROUNDS && alive[0] && alive[1]; round++) {
+    int i = 0;
+    while(i < f.count) {
+      // ships at the same skill fire simultaneously, so losses land after the whole step
+      int end = i;
+      while((end < f.count) && (f.skill[end] == f.skill[i])) end++;
+      uint8_t dmg[MAXSHIPS] = {0};
+      for(int a=i; a<end; a++) {
+        if(b.hull[a] == 0) continue;
+        int target = -1;
+        for(int t=0; t<f.count; t++) {
+          if((f.side[t] == f.side[a]) || (b.hull[t] == 0)) continue;
+          if((target == -1) || (b.hull[t]+b.shield[t] < b.hull[target]+b.shield[target])) target = t;
+        }
+        if(target == -1) break;
+        dmg[target] += RollAttack(rng, f.attack[a], f.agility[target]);
+      }
+      for(int t=0; t<f.count; t++) {
+        if(dmg[t] == 0 || b.hull[t] == 0) continue;
+        int s = std::min<int>(dmg[t], b.shield[t]);
+        b.shield[t] -= s;
+        b.hull[t] = std::max(0, b.hull[t] - (dmg[t] - s));
+        if(b.hull[t] == 0) alive[f.side[t]]--;
+      }
+      i = end;
+    }
+  }
+
+  left = {{0,0}};
+  for(int i=0; i<f.count; i++) {
+    if(b.hull[i]) left[f.side[i]] += f.cost[i];
+  }
+  if(alive[0] && !alive[1]) return 0;
+  if(alive[1] && !alive[0]) return 1;
+  // time - most points destroyed wins
+  int d0 = f.total[1] - left[1];
+  int d1 = f.total[0] - left[0];
+  return (d0 > d1) ? 0 : (d1 > d0) ? 1 : 2;
+}
+
+
+
+// each worker owns a range of game indexes and takes chunks off the front.
+// when it runs dry it steals the back half of another worker's range.
+struct WorkRange {
+  std::mutex lock;
+  uint64_t begin;
+  uint64_t end;
+};
+
+static bool TakeWork(std::vector<WorkRange> &ranges, unsigned self, uint64_t &b, uint64_t &e) {
+  for(;;) {
+    {
+      std::lock_guard<std::mutex> l(ranges[self].lock);
+      if(ranges[self].begin < ranges[self].end) {
+        b = ranges[self].begin;
+        e = std::min(b + CHUNK, ranges[self].end);
+        ranges[self].begin = e;
+        return true;
+      }
+    }
+    bool stole = false;
+    for(unsigned i=1; i<ranges.size() && !stole; i++) {
+      WorkRange &victim = ranges[(self+i) % ranges.size()];
+      std::lock_guard<std::mutex> l(victim.lock);
+      if(victim.end - victim.begin > CHUNK) {
+        uint64_t mid = victim.begin + (victim.end - victim.begin) / 2;
+        b = mid;
+        e = victim.end;
+        victim.end = mid;
+        stole = true;
+      }
+    }
+    if(!stole) return false;
+    std::lock_guard<std::mutex> l(ranges[self].lock);
+    ranges[self].begin = b;
+    ranges[self].end   = e;
+  }
+}
+
+struct Totals {
+  std::array<uint64_t, 3> results;
+  std::array<uint64_t, 2> left;
+};
+
+SimResult Simulate(std::array<Squad, 2>& players, uint64_t games, unsigned threads, uint64_t seed) {
+  Fleet fleet = BuildFleet(players);
+  if(threads == 0) threads = 1;
+
+  // the first games%threads ranges take one extra game
+  std::vector<WorkRange> ranges(threads);
+  uint64_t per   = games / threads;
+  uint64_t extra = games % threads;
+  for(unsigned t=0; t<threads; t++) {
+    ranges[t].begin = t * per + std::min<uint64_t>(t, extra);
+    ranges[t].end   = ranges[t].begin + per + ((t < extra) ? 1 : 0);
+  }
+  std::vector<Totals> totals(threads, Totals());
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for(unsigned t=0; t<threads; t++) {
+    try {
+      workers.emplace_back([&, t]() {
+          Totals tot = {};
+          uint64_t b, e;
+          while(TakeWork(ranges, t, b, e)) {
+            for(uint64_t g=b; g<e; g++) {
+              Rng rng(seed ^ (g * 0xD1B54A32D192ED03ULL));
+              std::array<uint16_t, 2> left;
+              tot.results[PlayGame(fleet, rng, left)]++;
+              tot.left[0] += left[0];
+              tot.left[1] += left[1];
+            }
+          }
+          totals[t] = tot;
+        });
+    }
+    catch(std::system_error &e) {
+      // stop the threads that did start before giving up
+      for(auto &r : ranges) {
+        std::lock_guard<std::mutex> l(r.lock);
+        r.begin = r.end;
+      }
+      for(auto &w : workers) w.join();
+      throw std::invalid_argument("Unable to start " + std::to_string(threads) + " threads: " + e.what());
+    }
+  }
+  for(auto &w : workers) w.join();
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  Totals sum = {};
+  for(auto &t : totals) {
+    for(int i=0; i<3; i++) sum.results[i] += t.results[i];
+    for(int i=0; i<2; i++) sum.left[i]    += t.left[i];
+  }
+
+  SimResult r;
+  r.games   = games;
+  r.wins    = {{ sum.results[0], sum.results[1] }};
+  r.draws   = sum.results[2];
+  r.survivingPoints = {{ games ? (double)sum.left[0]/games : 0, games ? (double)sum.left[1]/games : 0 }};
+  r.seconds = elapsed.count();
+  return r;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "./libxwing/squad.h"
+#include <array>
+#include <stdint.h>
+
+// simplified monte carlo engagements between 2 squads.
+// ships attack in pilot skill order (both sides focused, every attack at
+// the weakest enemy ship) until one side is gone or the round limit is hit.
+
+struct SimResult {
+  uint64_t games;
+  std::array<uint64_t, 2> wins;
+  uint64_t draws;
+  std::array<double, 2> survivingPoints; // average points left on the table per game
+  double seconds;
+};
+
+SimResult Simulate(std::array<Squad, 2>& players, uint64_t games, unsigned threads, uint64_t seed=0);